@@ -3,22 +3,58 @@
 #include <SD.h>
 #include "config.h"
 #include "sd_async.h"
+#include "sd_index.h"
+#include "sd_ring.h"
+#include "sd_segment.h"
+#include "fb_ref.h"
+#include "uplink.h"
+#include "frame_hdr.h"
+#include "motion.h"
+#include "perf_stats.h"
+#include <esp_rom_crc.h>
+#include <time.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+#include <esp_sleep.h>
+#include <driver/rtc_io.h>
 
 // SPI for SD
 SPIClass sdSPI(VSPI);
 
 // 运行时配置：仅保留与SD写入相关
 RuntimeConfig g_cfg = {
-  .saveEnabled   = true,
-  .asyncSDWrite  = true  // 默认启用异步写
+  .saveEnabled     = true,
+  .asyncSDWrite    = true,  // 默认启用异步写
+  .timelapseSec    = 0,
+  .burstFrames     = BURST_FRAMES_DEFAULT,
+  .burstIntervalMs = BURST_INTERVAL_MS_DEFAULT,
+  .adaptiveQuality = ADAPT_ENABLE,
+  .uploadEnabled   = UPLINK_ENABLE,
+  .motionEnabled   = MOTION_ENABLE
 };
 
 static uint32_t photo_index = 1;
+static uint32_t photo_index_durable = 0;   // 最近确认落盘的序号
+static uint32_t async_save_fail = 0;
+
+// 软复位后仍保留；上电后由 magic 判断无效
+static const uint32_t RTC_IDX_MAGIC = 0x50494458UL;
+RTC_NOINIT_ATTR static uint32_t rtc_idx_magic;
+RTC_NOINIT_ATTR static uint32_t rtc_photo_index;
+static uint32_t nvs_saved_index = 0;
+static uint32_t nvs_saved_ms = 0;
+
+// 已提交但尚未确认的异步保存，按提交顺序确认
+struct PendingSave{ SdTicket ticket; uint32_t index; };
+static PendingSave pending_saves[ASYNC_SD_QUEUE_LENGTH];
+static uint32_t pending_rd = 0, pending_wr = 0;
 static uint8_t  g_flashDuty = DEFAULT_FLASH_DUTY;
 
 bool camera_ok = false;
 static uint32_t camera_reinit_backoff_ms = 0;
 static uint32_t camera_next_reinit_allowed = 0;
+static int64_t  shot_frame_us = 0;   // 最近一次取到帧的时刻
 static uint32_t sd_remount_backoff_ms = 3000;
 static uint32_t sd_next_remount_allowed = 0;
 static const uint32_t CAMERA_BACKOFF_BASE = 3000;
@@ -93,37 +129,141 @@ camera_config_t make_config(framesize_t size,int xclk,int q){
   c.xclk_freq_hz=xclk;
   c.pixel_format=PIXFORMAT_JPEG;
   if(psramFound()){
-    c.frame_size=size; c.jpeg_quality=q; c.fb_count=1;
+    // 多帧缓冲：一帧交给写任务时，采集仍有空闲缓冲可用
+    c.frame_size=size; c.jpeg_quality=q; c.fb_count=CAMERA_FB_COUNT;
+    c.fb_location=CAMERA_FB_IN_PSRAM;
+    c.grab_mode=CAMERA_GRAB_LATEST;
   }else{
     c.frame_size=(size>FRAMESIZE_VGA?FRAMESIZE_VGA:size);
     c.jpeg_quality=q+5; c.fb_count=1;
+    c.fb_location=CAMERA_FB_IN_DRAM;
+    c.grab_mode=CAMERA_GRAB_WHEN_EMPTY;
   }
   return c;
 }
 
+// 当前参数；cam_geom_size 为驱动按其分配缓冲的尺寸，更大的尺寸只能重建驱动
+static CamParams cam_cur = { FRAME_SIZE_PREF, JPEG_QUALITY_PREF, -1, -1 };
+static framesize_t cam_geom_size = FRAMESIZE_INVALID;
+static CamSwitchStats cam_switch = {};
+static bool apply_sensor_params(const CamParams& p,bool force);
+
+// 上次启动成功的档位：RTC 内存（软复位后）与 NVS（上电后），启动时先试一次，
+// 省掉首选配置反复失败的重试延时。只记启动阶梯的档位，运行时重建（调参、反压降级、
+// 降频重试）不改它；缓存的是降级档时启动先单试一次首选档，不会一直停在降级配置
+struct CamGoodCfg{
+  uint32_t magic;
+  uint8_t  size;
+  uint8_t  quality;    // 传给 make_config 的请求值
+  uint8_t  xclk_mhz;
+  int8_t   agc_gain;
+  int16_t  aec_value;
+  uint16_t reserved;
+};
+static const uint32_t CAM_GOOD_MAGIC=0x43414D47UL;   // "CAMG"
+RTC_NOINIT_ATTR static CamGoodCfg rtc_cam_good;
+static CamGoodCfg nvs_cam_good={};
+static bool nvs_cam_good_read=false;   // nvs_cam_good 已与 NVS 同步
+
+static bool nvs_cam_good_load(){
+  if(nvs_cam_good_read) return true;
+  Preferences p;
+  if(!p.begin(NVS_NS_CAM,true)) return false;
+  if(p.getBytes(NVS_KEY_CAM_GOOD,&nvs_cam_good,sizeof(nvs_cam_good))!=sizeof(nvs_cam_good))
+    memset(&nvs_cam_good,0,sizeof(nvs_cam_good));
+  p.end();
+  nvs_cam_good_read=true;
+  return true;
+}
+
+static bool cam_good_load(CamGoodCfg& g){
+  if(rtc_cam_good.magic==CAM_GOOD_MAGIC){ g=rtc_cam_good; return true; }
+  if(!nvs_cam_good_load() || nvs_cam_good.magic!=CAM_GOOD_MAGIC) return false;
+  g=nvs_cam_good;
+  return true;
+}
+
+static bool cam_good_is_pref(const CamGoodCfg& g){
+  return g.size==FRAME_SIZE_PREF && g.quality==JPEG_QUALITY_PREF && g.xclk_mhz==20;
+}
+
+// RTC 每次更新；NVS 只在初始化成功且内容变化时写，避免磨损。
+// 配置取自 RTC 时 nvs_cam_good 尚未读过，先读出再比较，否则每次唤醒都会重写
+static void cam_good_store(bool to_nvs){
+  rtc_cam_good.aec_value=cam_cur.aec_value;
+  rtc_cam_good.agc_gain=cam_cur.agc_gain;
+  if(!to_nvs || !nvs_cam_good_load() || memcmp(&rtc_cam_good,&nvs_cam_good,sizeof(CamGoodCfg))==0) return;
+  Preferences p;
+  if(!p.begin(NVS_NS_CAM,false)) return;
+  if(p.putBytes(NVS_KEY_CAM_GOOD,&rtc_cam_good,sizeof(CamGoodCfg))==sizeof(CamGoodCfg)) nvs_cam_good=rtc_cam_good;
+  p.end();
+}
+
 bool try_camera_init_once(framesize_t size,int xclk,int q){
   camera_config_t cfg=make_config(size,xclk,q);
   esp_err_t err=esp_camera_init(&cfg);
-
+  if(err==ESP_OK){
+    cam_geom_size=cfg.frame_size;
+    cam_cur.size=cfg.frame_size;
+    cam_cur.quality=cfg.jpeg_quality;
+  }
   return err==ESP_OK;
 }
 
-bool init_camera_multi(){
-  pinMode(PWDN_GPIO,OUTPUT); digitalWrite(PWDN_GPIO,LOW); delay(30);
+// 启动阶梯的一档：成功即记为上次成功档位
+static bool init_rung(framesize_t size,int xclk,int q){
+  if(!try_camera_init_once(size,xclk,q)) return false;
+  rtc_cam_good.magic=CAM_GOOD_MAGIC;
+  rtc_cam_good.size=(uint8_t)size;
+  rtc_cam_good.quality=(uint8_t)q;
+  rtc_cam_good.xclk_mhz=(uint8_t)(xclk/1000000);
+  rtc_cam_good.reserved=0;
+  return true;
+}
+
+static bool init_camera_ladder(){
   for(int i=0;i<INIT_RETRY_PER_CONFIG;i++){
-    if(try_camera_init_once(FRAME_SIZE_PREF,20000000,JPEG_QUALITY_PREF)) return true;
+    if(init_rung(FRAME_SIZE_PREF,20000000,JPEG_QUALITY_PREF)) return true;
     delay(120);
   }
   esp_camera_deinit(); delay(60);
   for(int i=0;i<INIT_RETRY_PER_CONFIG;i++){
-    if(try_camera_init_once(FRAME_SIZE_FALLBACK,10000000,JPEG_QUALITY_FALLBACK)) return true;
+    if(init_rung(FRAME_SIZE_FALLBACK,10000000,JPEG_QUALITY_FALLBACK)) return true;
     delay(150);
   }
   esp_camera_deinit();
   return false;
 }
 
-void deinit_camera_silent(){ esp_camera_deinit(); delay(50); }
+bool init_camera_multi(){
+  pinMode(PWDN_GPIO,OUTPUT); digitalWrite(PWDN_GPIO,LOW); delay(30);
+  CamGoodCfg g;
+  if(cam_good_load(g)){
+    bool ok=false;
+    if(!cam_good_is_pref(g)){   // 缓存为降级档：先单试一次首选档
+      ok=init_rung(FRAME_SIZE_PREF,20000000,JPEG_QUALITY_PREF);
+      if(!ok){ esp_camera_deinit(); delay(60); }
+    }
+    if(ok || init_rung((framesize_t)g.size,g.xclk_mhz*1000000,g.quality)){
+      CamParams p=cam_cur;
+      p.aec_value=g.aec_value; p.agc_gain=g.agc_gain;
+      apply_sensor_params(p,false);
+      cam_good_store(true);
+      return true;
+    }
+    esp_camera_deinit(); delay(60);
+    rtc_cam_good.magic=0;
+  }
+  if(init_camera_ladder()){ cam_good_store(true); return true; }
+  return false;
+}
+
+// 所有 deinit 路径（调参重建、反压降级、故障重试、入睡）都经这里
+void deinit_camera_silent(){
+  uplink_release_fbs();     // 上传与写任务可能仍持有 fb，须全部归还后才能释放缓冲
+  sd_async_release_fbs();
+  esp_camera_deinit(); delay(50);
+}
 
 bool discard_frames(int n){
   for(int i=0;i<n;i++){
@@ -136,18 +276,138 @@ bool discard_frames(int n){
 
 bool reinit_camera_with_params(framesize_t size,int quality){
   deinit_camera_silent();
-  camera_config_t cfg=make_config(size,20000000,quality);
-  if(esp_camera_init(&cfg)==ESP_OK){
+  if(try_camera_init_once(size,20000000,quality)) return true;
+  deinit_camera_silent();
+  return try_camera_init_once(size,10000000,quality+2);
+}
 
+// 只写与当前值不同的寄存器；曝光/增益 <0 表示交还自动控制
+static bool apply_sensor_params(const CamParams& p,bool force){
+  sensor_t *s=esp_camera_sensor_get();
+  if(!s) return false;
+  int rc=0;
+  if(force || p.size!=cam_cur.size) rc|=s->set_framesize(s,p.size);
+  if(force || p.quality!=cam_cur.quality) rc|=s->set_quality(s,p.quality);
+  if(force || p.aec_value!=cam_cur.aec_value){
+    rc|=s->set_exposure_ctrl(s,p.aec_value<0);
+    if(p.aec_value>=0) rc|=s->set_aec_value(s,p.aec_value);
   }
-  deinit_camera_silent();
-  cfg=make_config(size,10000000,quality+2);
-  if(esp_camera_init(&cfg)==ESP_OK){
+  if(force || p.agc_gain!=cam_cur.agc_gain){
+    rc|=s->set_gain_ctrl(s,p.agc_gain<0);
+    if(p.agc_gain>=0) rc|=s->set_agc_gain(s,p.agc_gain);
+  }
+  if(rc==0) cam_cur=p;
+  return rc==0;
+}
+
+// 改尺寸后缓冲里可能还有旧尺寸的帧，丢到出现新尺寸为止
+static bool wait_frame_size(framesize_t size){
+  for(int i=0;i<CAMERA_FB_COUNT+2;i++){
+    camera_fb_t *fb=esp_camera_fb_get();
+    if(!fb) return false;
+    bool match=(fb->width==resolution[size].width);
+    esp_camera_fb_return(fb);
+    if(match) return true;
+  }
+  return false;
+}
+
+bool camera_set_params(const CamParams& p){
+  if(!camera_ok) return false;
+  int64_t t0=esp_timer_get_time();
+  bool size_changed=(p.size!=cam_cur.size);
+  bool ok;
+  bool full=(cam_geom_size==FRAMESIZE_INVALID || p.size>cam_geom_size);
+  if(full){
+    // 缓冲需要变大：只能重建驱动，再补上曝光/增益
+    CamParams want=p;
+    ok=reinit_camera_with_params(p.size,p.quality);
+    camera_ok=ok;
+    if(ok){
+      if(want.size>cam_geom_size) want.size=cam_geom_size;   // 无 PSRAM 时被限到 VGA
+      ok=apply_sensor_params(want,true);
+      discard_frames(DISCARD_FRAMES_ON_START);
+    }
+  }else{
+    ok=apply_sensor_params(p,false);
+    if(ok && size_changed) ok=wait_frame_size(p.size);
+  }
+  uint32_t us=(uint32_t)(esp_timer_get_time()-t0);
+  if(!ok){ cam_switch.fail++; return false; }
+  cam_good_store(false);
+  if(full){
+    cam_switch.full++;
+    cam_switch.full_us_last=us;
+    if(us>cam_switch.full_us_max) cam_switch.full_us_max=us;
+  }else{
+    cam_switch.live++;
+    cam_switch.live_us_last=us;
+    if(us>cam_switch.live_us_max) cam_switch.live_us_max=us;
+  }
+  return true;
+}
+
+void camera_get_params(CamParams& out){ out=cam_cur; }
+
+// 启动并行化：摄像头在独立任务中初始化（含丢弃启动帧），主任务同时挂载 SD
+static uint32_t boot_ms[BOOT_PHASES]={0};
+static SemaphoreHandle_t cam_init_done=nullptr;
+
+void boot_mark(BootPhase ph){
+  if(ph<BOOT_PHASES) boot_ms[ph]=(uint32_t)(esp_timer_get_time()/1000);
+}
+
+void boot_log(Print& out){
+  out.printf("Boot(ms): sd=%lu idx=%lu cam=%lu first_frame=%lu ready=%lu\n",
+             (unsigned long)boot_ms[BOOT_SD],(unsigned long)boot_ms[BOOT_INDEX],
+             (unsigned long)boot_ms[BOOT_CAM],(unsigned long)boot_ms[BOOT_FIRST_FRAME],
+             (unsigned long)boot_ms[BOOT_READY]);
+}
 
+static void camera_init_task(void*){
+  bool ok=init_camera_multi();
+  boot_mark(BOOT_CAM);
+  if(ok && discard_frames(1)){
+    boot_mark(BOOT_FIRST_FRAME);
+    if(DISCARD_FRAMES_ON_START>1) discard_frames(DISCARD_FRAMES_ON_START-1);
   }
+  camera_ok=ok;
+  xSemaphoreGive(cam_init_done);
+  vTaskDelete(nullptr);
+}
+
+static void dump_stats(Print& out){
+  CamSwitchStats cs;
+  camera_get_switch_stats(cs);
+  if(cs.live || cs.full || cs.fail)
+    out.printf("cam switch: live=%lu last=%luus max=%luus, full=%lu last=%luus max=%luus, fail=%lu\n",
+               (unsigned long)cs.live, (unsigned long)cs.live_us_last, (unsigned long)cs.live_us_max,
+               (unsigned long)cs.full, (unsigned long)cs.full_us_last, (unsigned long)cs.full_us_max,
+               (unsigned long)cs.fail);
+  AdaptStats as;
+  capture_get_adapt_stats(as);
+  out.printf("adapt: level=%u/%u down=%lu up=%lu occ=%lu%% util=%lu%% wr=%lukB/s\n",
+             (unsigned)as.level, (unsigned)as.levels,
+             (unsigned long)as.steps_down, (unsigned long)as.steps_up,
+             (unsigned long)as.occ_pct, (unsigned long)as.util_pct, (unsigned long)as.write_kBps);
+}
 
+bool camera_init_async(){
+  perf_add_dump(dump_stats);
+  if(!cam_init_done) cam_init_done=xSemaphoreCreateBinary();
+  if(!cam_init_done) return false;
+  // 放在写任务所在核：启动阶段写任务空闲，主任务（SD 挂载）在另一个核
+  return xTaskCreatePinnedToCore(camera_init_task,"caminit",CAM_INIT_TASK_STACK,nullptr,
+                                 2,nullptr,ASYNC_SD_TASK_CORE)==pdPASS;
 }
 
+bool camera_init_wait(uint32_t timeout_ms){
+  if(!cam_init_done) return camera_ok;
+  xSemaphoreTake(cam_init_done,pdMS_TO_TICKS(timeout_ms));
+  return camera_ok;
+}
+void camera_get_switch_stats(CamSwitchStats& out){ out=cam_switch; }
+
 void schedule_camera_backoff(){
   camera_reinit_backoff_ms = camera_reinit_backoff_ms? min<uint32_t>(camera_reinit_backoff_ms*2,CAMERA_BACKOFF_MAX):CAMERA_BACKOFF_BASE;
   camera_next_reinit_allowed=millis()+camera_reinit_backoff_ms;
@@ -155,35 +415,171 @@ void schedule_camera_backoff(){
 void attempt_camera_reinit_with_backoff(){
   uint32_t now=millis();
   if(now<camera_next_reinit_allowed) return;
+  CamParams keep=cam_cur;
   deinit_camera_silent();
   camera_ok=init_camera_multi();
-  if(!camera_ok) schedule_camera_backoff(); else camera_reinit_backoff_ms=0;
+  if(!camera_ok){ schedule_camera_backoff(); return; }
+  camera_reinit_backoff_ms=0;
+  // 恢复运行时设置的参数；尺寸超出新缓冲时保持初始化尺寸
+  if(keep.size>cam_geom_size) keep.size=cam_cur.size;
+  apply_sensor_params(keep,false);
 }
 
-// SD 保存
-static bool save_frame_to_sd_raw(const uint8_t* data,size_t len,uint32_t index){
+// SD 保存：按 SD_INDEX_BUCKET 分桶目录，成功后追加索引记录
+static void photo_path(char* out,size_t n,uint32_t index){
+  sd_index_path(index,out,n);
+}
+
+static SdFileMeta photo_meta(uint32_t index,uint8_t trigger){
+  SdFileMeta m;
+  m.index=index;
+  m.ts=(uint32_t)time(nullptr);
+  m.trigger=trigger;
+  return m;
+}
+
+// 同步写：各段依次写入，ENABLE_FRAME_HEADER 时段间插入头、末尾追加 CRC 尾（与写任务格式一致），
+// 按当前输出模式写独立文件、段容器或循环槽。
+// 索引记录经写任务排在更早的帧之后追加，保持按序号递增，不必等写任务排空
+static bool save_frame_to_sd_raw(camera_fb_t *fb,uint32_t index,uint8_t trigger){
   if(SD.cardType()==CARD_NONE) return false;
-  uint64_t free=(SD.totalBytes()-SD.usedBytes());
-  if(free/(1024*1024) < SD_MIN_FREE_MB) return false;
-  char name[48]; snprintf(name,sizeof(name),"/photo_%05lu.jpg",(unsigned long)index);
-  File f=SD.open(name,FILE_WRITE); if(!f) return false;
-  size_t w=f.write(data,len); f.close(); return w==len;
+  SdFileMeta m=photo_meta(index,trigger);
+  FrameHdr h; SdIov v[4];
+  uint8_t n=frame_hdr_iov(fb,m,h,v);
+  uint32_t crc=0,len=0;
+  for(uint8_t i=0;i<n;i++){ crc=esp_rom_crc32_le(crc,v[i].data,v[i].len); len+=v[i].len; }
+  FrameTrailer tr{crc,FRAME_TRAILER_MAGIC};
+  if(n>1){
+    v[n++]={(const uint8_t*)&tr,sizeof(tr)};
+    crc=esp_rom_crc32_le(crc,(const uint8_t*)&tr,sizeof(tr));
+    len+=sizeof(tr);
+  }
+  if(sd_async_get_output_mode()==SD_OUT_RING){
+    // 循环录制：覆盖最旧槽，不检查剩余空间；槽头即索引，不追加记录
+    RingFrame rf;
+    if(!sd_ring_begin(rf,m.index,len,m.ts,m.trigger)) return false;
+    for(uint8_t i=0;i<n;i++) sd_ring_append(rf,v[i].data,v[i].len);
+    return sd_ring_end(rf,crc);
+  }
+  PhotoIndexRec r{};
+  if(sd_async_get_output_mode()==SD_OUT_SEGMENT){
+    // 段文件只有一个写入点：等写任务写完已提交的帧（与提交同一等待上限），整帧期间挡住其空闲维护
+    SdTicket last=sd_async_last_ticket();
+    if(last && sd_async_wait(last,ASYNC_SD_SUBMIT_TIMEOUT_MS)==SDW_PENDING) return false;
+    sd_segment_lock();
+    bool ok=sd_segment_begin(m.index,len,m.ts,m.trigger);
+    if(ok){
+      for(uint8_t i=0;i<n;i++) sd_segment_append(v[i].data,v[i].len);
+      ok=sd_segment_end(crc,r.offset);
+      snprintf(r.path,sizeof(r.path),"%s",sd_segment_path());
+    }
+    sd_segment_unlock();
+    if(!ok) return false;
+  }else{
+    char name[48];
+    photo_path(name,sizeof(name),index);
+    // 索引记录放不下的路径不写，免得索引指向不存在的文件
+    if(snprintf(r.path,sizeof(r.path),"%s",name)>=(int)sizeof(r.path)) return false;
+    if(!sd_async_space_ok(len)) return false;
+    sd_index_prepare_dir(name);
+    File f=SD.open(name,FILE_WRITE); if(!f) return false;
+    size_t w=0;
+    for(uint8_t i=0;i<n;i++) w+=f.write(v[i].data,v[i].len);
+    f.close();
+    sd_async_note_written(w);
+    if(w!=len) return false;
+  }
+
+  r.index=index; r.size=len; r.ts=m.ts; r.trigger=trigger;
+  r.crc=crc;
+  return sd_async_submit_index(r);
+}
+
+// 序号持久化
+static void photo_index_persist(bool force){
+  rtc_photo_index=photo_index;
+  rtc_idx_magic=RTC_IDX_MAGIC;
+  if(photo_index==nvs_saved_index) return;
+  uint32_t now=millis();
+  if(!force){
+    if(photo_index-nvs_saved_index < SAVE_PARAMS_INTERVAL_IMAGES) return;
+    if(nvs_saved_ms && now-nvs_saved_ms < NVS_MIN_SAVE_INTERVAL_MS) return;
+  }
+  Preferences p;
+  if(!p.begin(NVS_NS_CAM,false)) return;
+  p.putUInt(NVS_KEY_PHOTO_IDX,photo_index);
+  p.end();
+  nvs_saved_index=photo_index;
+  nvs_saved_ms=now;
+}
+
+void photo_index_restore(){
+  uint32_t next=1;
+  if(rtc_idx_magic==RTC_IDX_MAGIC && rtc_photo_index>next) next=rtc_photo_index;
+  Preferences p;
+  if(p.begin(NVS_NS_CAM,true)){
+    nvs_saved_index=p.getUInt(NVS_KEY_PHOTO_IDX,0);
+    p.end();
+    if(nvs_saved_index>next) next=nvs_saved_index;
+  }
+  // NVS 最多落后一批；索引尾部补上这部分
+  uint32_t tail=0;
+  if(sd_index_tail_max(tail) && tail+1>next) next=tail+1;
+  if(sd_ring_last_index(tail) && tail+1>next) next=tail+1;
+  photo_index=next;
+  photo_index_durable=next-1;
+  rtc_photo_index=next;
+  rtc_idx_magic=RTC_IDX_MAGIC;
 }
 
-// 同步/异步统一入口
-static bool save_frame_to_sd(camera_fb_t *fb,uint32_t index){
+uint32_t photo_index_next(){ return photo_index; }
+
+// 确认已完成的异步保存；失败的若是最新一张则回收其序号，否则留空号
+static void reap_pending_saves(){
+  while(pending_rd!=pending_wr){
+    PendingSave &p=pending_saves[pending_rd%ASYNC_SD_QUEUE_LENGTH];
+    SdWriteStatus st=sd_async_poll(p.ticket);
+    if(st==SDW_PENDING) return;
+    pending_rd++;
+    if(st==SDW_OK){ photo_index_durable=p.index; continue; }
+    async_save_fail++;
+    if(pending_rd==pending_wr && photo_index==p.index+1) photo_index=p.index;
+  }
+}
+
+static void track_pending_save(SdTicket t,uint32_t index){
+  if(pending_wr-pending_rd>=ASYNC_SD_QUEUE_LENGTH){
+    // 跟踪表满：只等最早的一张，而非清空整个队列
+    sd_async_wait(pending_saves[pending_rd%ASYNC_SD_QUEUE_LENGTH].ticket);
+    reap_pending_saves();
+    if(pending_wr-pending_rd>=ASYNC_SD_QUEUE_LENGTH) pending_rd++;
+  }
+  pending_saves[pending_wr%ASYNC_SD_QUEUE_LENGTH]={t,index};
+  pending_wr++;
+}
+
+// 同步/异步统一入口；ticket!=0 表示 fb 已交给写任务：
+// fb 已登记引用时写任务持有自己的一份，否则调用方不得再归还
+static bool save_frame_to_sd(camera_fb_t *fb,uint32_t index,uint8_t trigger,SdTicket &ticket){
+  ticket=0;
   if(!fb) return false;
   char name[48];
-  snprintf(name,sizeof(name),"/photo_%05lu.jpg",(unsigned long)index);
+  photo_path(name,sizeof(name),index);
   if(g_cfg.asyncSDWrite){
-    if(sd_async_submit(name, fb->buf, fb->len)){
+    SdFileMeta m=photo_meta(index,trigger);
+    FrameHdr h; SdIov v[3];
+    uint8_t n=frame_hdr_iov(fb,m,h,v);
+    bool ref=fb_ref_add(fb);
+    ticket=sd_async_submit_v(name, v, n, fb, ASYNC_SD_SUBMIT_TIMEOUT_MS, &m, n>1?SD_SUBMIT_CRC_TRAILER:0);
+    if(ticket){
       return true;
     }else{
+      if(ref) fb_ref_release(fb);
 
-      return save_frame_to_sd_raw(fb->buf, fb->len, index);
+      return save_frame_to_sd_raw(fb, index, trigger);
     }
   }else{
-    return save_frame_to_sd_raw(fb->buf, fb->len, index);
+    return save_frame_to_sd_raw(fb, index, trigger);
   }
 }
 
@@ -199,7 +595,10 @@ void init_sd(){
       sd_async_start();
       async_started = true;
     }
+    sd_index_open();
     sd_async_on_sd_ready();
+    // 循环录制：先统计剩余空间，挂载只建少量槽，其余由写任务空闲时补建，热路径不再分配
+    if(sd_async_get_output_mode()==SD_OUT_RING) sd_ring_mount();
   }
 }
 
@@ -208,6 +607,8 @@ void periodic_sd_check(){
   if(SD.cardType()!=CARD_NONE){ sd_remount_backoff_ms=3000; return; }
   if(now<sd_next_remount_allowed) return;
   sd_async_on_sd_lost();
+  sd_index_close();
+  sd_ring_unmount();
   init_sd();
   if(SD.cardType()==CARD_NONE){
     sd_remount_backoff_ms=min<uint32_t>(sd_remount_backoff_ms*2,SD_BACKOFF_MAX);
@@ -215,39 +616,168 @@ void periodic_sd_check(){
   }else sd_remount_backoff_ms=3000;
 }
 
-// 单次拍照
-static uint8_t capture_once_internal(uint8_t /*trigger*/){
-  if(!camera_ok) return CR_CAMERA_NOT_READY;
+// 反压自适应：每个窗口比较提交字节率与写卡吞吐，并看队列/环形区占用；
+// 降级立即生效，恢复要求持续低负载且距上次调整足够久，避免来回抖动
+struct AdaptLevel{ framesize_t size; int8_t quality; };
+static uint8_t  adapt_level=0;
+static uint32_t adapt_win_ms=0;
+static uint32_t adapt_calm_since=0;
+static uint32_t adapt_last_change_ms=0;
+static uint32_t adapt_bytes_in=0;               // 窗口内提交的帧字节
+static uint32_t adapt_wr_bytes=0,adapt_wr_ms=0; // 上个窗口末写任务的累计值
+static uint32_t adapt_bw=0;                     // 写卡吞吐 B/s
+static AdaptStats adapt_stats={};
 
-  if(DISCARD_FRAMES_EACH_SHOT>0) discard_frames(DISCARD_FRAMES_EACH_SHOT);
+static const uint8_t ADAPT_Q_LEVELS=(JPEG_QUALITY_FALLBACK-JPEG_QUALITY_PREF+ADAPT_Q_STEP-1)/ADAPT_Q_STEP;
+static const uint8_t ADAPT_LEVELS=ADAPT_Q_LEVELS+2;   // 质量各级 + 降尺寸一级
 
-  flashOn();
-#if FLASH_MODE
-  delay(FLASH_WARM_MS);
-#else
-  delay(FLASH_ON_TIME_MS_DIGITAL);
-#endif
+static AdaptLevel adapt_at(uint8_t l){
+  if(l<=ADAPT_Q_LEVELS){
+    int q=JPEG_QUALITY_PREF+l*ADAPT_Q_STEP;
+    if(q>JPEG_QUALITY_FALLBACK) q=JPEG_QUALITY_FALLBACK;
+    return {FRAME_SIZE_PREF,(int8_t)q};
+  }
+  return {FRAME_SIZE_FALLBACK,(int8_t)JPEG_QUALITY_FALLBACK};
+}
 
-  camera_fb_t *fb=esp_camera_fb_get();
-  if(!fb){
-    delay(20); fb=esp_camera_fb_get();
-    if(!fb){ flashOff(); return CR_FRAME_GRAB_FAIL; }
+static void adapt_step(){
+  // 无 PSRAM 时没有异步环形区，make_config 也已固定在低档
+  if(!g_cfg.adaptiveQuality || !g_cfg.asyncSDWrite || !camera_ok || !psramFound()) return;
+  uint32_t now=millis();
+  SdAsyncStats st;
+  if(!adapt_win_ms){
+    sd_async_get_stats(st);
+    adapt_win_ms=now; adapt_wr_bytes=st.bytes_written; adapt_wr_ms=st.write_ms; adapt_bytes_in=0;
+    return;
+  }
+  uint32_t win=now-adapt_win_ms;
+  if(win<ADAPT_WINDOW_MS) return;
+  sd_async_get_stats(st);
+  uint32_t occ_q=st.q_depth*100/ASYNC_SD_QUEUE_LENGTH;
+  uint32_t occ_p=st.pool_total?(st.pool_total-st.pool_free)*100/st.pool_total:0;
+  uint32_t occ=max(occ_q,occ_p);
+  uint32_t dbytes=st.bytes_written-adapt_wr_bytes, dms=st.write_ms-adapt_wr_ms;
+  if(dms>=20 && dbytes) adapt_bw=(uint32_t)((uint64_t)dbytes*1000/dms);   // 窗口内几乎没写则沿用上次
+  uint32_t in_bps=(uint32_t)((uint64_t)adapt_bytes_in*1000/win);
+  uint32_t util=adapt_bw?(uint32_t)((uint64_t)in_bps*100/adapt_bw):0;
+  adapt_win_ms=now; adapt_wr_bytes=st.bytes_written; adapt_wr_ms=st.write_ms; adapt_bytes_in=0;
+
+  uint8_t want=adapt_level;
+  if(occ>=ADAPT_HIGH_PCT || util>=ADAPT_UTIL_HIGH_PCT){
+    adapt_calm_since=0;
+    if(adapt_level+1<ADAPT_LEVELS) want=adapt_level+1;
+  }else if(occ<=ADAPT_LOW_PCT && util<=ADAPT_UTIL_LOW_PCT){
+    if(!adapt_calm_since) adapt_calm_since=now;
+    if(adapt_level && now-adapt_calm_since>=ADAPT_UP_HOLD_MS
+       && now-adapt_last_change_ms>=ADAPT_UP_HOLD_MS) want=adapt_level-1;
+  }else adapt_calm_since=0;
+
+  if(want!=adapt_level){
+    AdaptLevel l=adapt_at(want);
+    CamParams p; camera_get_params(p);
+    p.size=(l.size>cam_geom_size)?cam_geom_size:l.size;
+    p.quality=l.quality;
+    if(camera_set_params(p)){
+      if(want>adapt_level) adapt_stats.steps_down++; else adapt_stats.steps_up++;
+      adapt_level=want;
+      adapt_last_change_ms=now;
+      adapt_calm_since=0;
+    }
   }
+  adapt_stats.level=adapt_level;
+  adapt_stats.levels=ADAPT_LEVELS;
+  adapt_stats.occ_pct=occ;
+  adapt_stats.util_pct=util;
+  adapt_stats.write_kBps=adapt_bw/1024;
+}
+
+void capture_get_adapt_stats(AdaptStats& out){ out=adapt_stats; }
+
+// 预触发：开灯后不再固定延时，直接连续取帧，让 AE/AWB 在出帧过程中收敛；
+// 相邻两帧 JPEG 大小（随亮度变化）趋稳即取当前帧，最长 FLASH_SETTLE_MAX_MS。
+// 每次拍照要丢的帧（DISCARD_FRAMES_EACH_SHOT）也在这段时间里一并消耗
+static camera_fb_t* grab_settled_frame(){
+  const int min_frames=max(FLASH_SETTLE_MIN_FRAMES,DISCARD_FRAMES_EACH_SHOT+1);
+  uint32_t t0=millis();
+  uint32_t prev=0;
+  int n=0,miss=0;
+  while(true){
+    uint32_t cc=perf_cc();
+    camera_fb_t *fb=esp_camera_fb_get();
+    if(!fb){
+      if(++miss>1) return nullptr;
+      delay(20);
+      continue;
+    }
+    perf_record_cc(PS_FB_GET,cc);
+    n++;
+    bool settled=false;
+    if(n>=min_frames && prev){
+      uint32_t d=fb->len>prev?fb->len-prev:prev-fb->len;
+      settled=(uint64_t)d*100<=(uint64_t)prev*FLASH_SETTLE_PCT;
+    }
+    if(settled || millis()-t0>=FLASH_SETTLE_MAX_MS){
+      perf_record(PS_SETTLE_FRAMES,n);
+      return fb;
+    }
+    prev=fb->len;
+    esp_camera_fb_return(fb);
+  }
+}
+
+// 上传与写卡共用同一帧缓冲，各持一份引用；上传队列满时本帧不上传
+static void upload_frame(camera_fb_t *fb,uint32_t index,bool shared){
+#if UPLINK_ENABLE
+  if(!g_cfg.uploadEnabled || !shared) return;
+  fb_ref_add(fb);
+  if(!uplink_submit_fb(fb,index)) fb_ref_release(fb);
+#endif
+}
+
+// 单次拍照
+static uint8_t capture_once_internal(uint8_t trigger){
+  if(!camera_ok) return CR_CAMERA_NOT_READY;
+  reap_pending_saves();
+  adapt_step();
+
+  uint32_t cc=perf_cc();
+  flashOn();
+  camera_fb_t *fb=grab_settled_frame();
+  // 帧已曝光完成，立即关灯，不陪着写卡
+  flashOff();
+  perf_record_cc(PS_FLASH_ON,cc);
+  if(!fb) return CR_FRAME_GRAB_FAIL;
+  perf_record_cc(PS_FLASH_WARM,cc);
+  shot_frame_us=esp_timer_get_time();
 
   uint32_t frame_len=fb->len;
   uint32_t index=photo_index;
   bool sdOk=true;
+  SdTicket ticket=0;
 
-  if(g_cfg.saveEnabled) sdOk=save_frame_to_sd(fb,index);
+  perf_record(PS_FRAME_SIZE,frame_len);
+  bool shared=fb_ref_begin(fb);   // 本函数持有第一份引用
+#if DEFAULT_SEND_BEFORE_SAVE
+  upload_frame(fb,index,shared);
+#endif
+  cc=perf_cc();
+  if(g_cfg.saveEnabled) sdOk=save_frame_to_sd(fb,index,trigger,ticket);
+  perf_record_cc(PS_SUBMIT,cc);
+#if !DEFAULT_SEND_BEFORE_SAVE
+  upload_frame(fb,index,shared);
+#endif
 
+  // 异步保存先占用序号，落盘失败时由 reap_pending_saves() 回收
   if(sdOk || !g_cfg.saveEnabled){
     photo_index++;
+    if(ticket){ track_pending_save(ticket,index); adapt_bytes_in+=frame_len; }
+    else if(g_cfg.saveEnabled) photo_index_durable=index;
+    photo_index_persist(false);
   }
 
-  esp_camera_fb_return(fb);
-  flashOff();
+  if(shared) fb_ref_release(fb);
+  else if(!ticket) esp_camera_fb_return(fb);
 
-  (void)frame_len; // 若需要可用于日志
   if(!sdOk && g_cfg.saveEnabled) return CR_SD_SAVE_FAIL;
   return CR_OK;
 }
@@ -265,6 +795,308 @@ bool capture_and_process(uint8_t trigger){
   return true;
 }
 
+// 连拍：闪光灯只预热一次；帧交给写任务后立即取下一帧，
+// fb_count=2 + CAMERA_GRAB_LATEST 使传感器出帧与写卡重叠
+static BurstStats burst_stats = {};
+
+bool capture_burst(uint8_t trigger,uint16_t frames,uint32_t interval_ms){
+  if(!camera_ok) return false;
+  if(frames==0) return true;
+  if(frames>BURST_FRAMES_MAX) frames=BURST_FRAMES_MAX;
+  reap_pending_saves();
+
+  int64_t flash_us=esp_timer_get_time();   // 连拍可能超过周期计数器的回绕时间
+  flashOn();
+  // 预热帧只用于等曝光收敛，不保存
+  camera_fb_t *warm=grab_settled_frame();
+  if(warm) esp_camera_fb_return(warm);
+  perf_record(PS_FLASH_WARM,(uint32_t)(esp_timer_get_time()-flash_us));
+
+  uint32_t ok=0,dropped=0;
+  uint32_t t0=millis();
+  for(uint16_t i=0;i<frames;i++){
+    if(interval_ms){
+      int32_t wait=(int32_t)(t0+i*interval_ms-millis());
+      if(wait>0) vTaskDelay(pdMS_TO_TICKS(wait));
+    }
+    // 连拍中不调档：调档会重建摄像头，闪光灯亮着也要中断出帧；提交字节照常计入窗口
+    uint32_t cc=perf_cc();
+    camera_fb_t *fb=esp_camera_fb_get();
+    if(!fb){ dropped++; continue; }
+    perf_record_cc(PS_FB_GET,cc);
+    perf_record(PS_FRAME_SIZE,fb->len);
+    if(!g_cfg.saveEnabled){ esp_camera_fb_return(fb); ok++; continue; }
+
+    uint32_t index=photo_index;
+    if(g_cfg.asyncSDWrite){
+      // 不等待写队列：满则丢弃本帧，保持节拍
+      char name[48]; photo_path(name,sizeof(name),index);
+      SdFileMeta m=photo_meta(index,trigger);
+      cc=perf_cc();
+      uint32_t len=fb->len;
+      FrameHdr h; SdIov v[3];
+      uint8_t n=frame_hdr_iov(fb,m,h,v);
+      SdTicket t=sd_async_submit_v(name,v,n,fb,0,&m,n>1?SD_SUBMIT_CRC_TRAILER:0);
+      perf_record_cc(PS_SUBMIT,cc);
+      if(!t){ esp_camera_fb_return(fb); dropped++; continue; }
+      adapt_bytes_in+=len;
+      photo_index++;
+      track_pending_save(t,index);
+    }else{
+      bool w=save_frame_to_sd_raw(fb,index,trigger);
+      esp_camera_fb_return(fb);
+      if(!w){ dropped++; continue; }
+      photo_index++;
+      photo_index_durable=index;
+    }
+    ok++;
+  }
+  uint32_t ms=millis()-t0;
+  flashOff();
+  perf_record(PS_FLASH_ON,(uint32_t)(esp_timer_get_time()-flash_us));
+  photo_index_persist(false);
+  adapt_step();   // 关灯后再按连拍期间的负载调档
+
+  burst_stats.bursts++;
+  burst_stats.frames_ok+=ok;
+  burst_stats.frames_dropped+=dropped;
+  burst_stats.last_frames=ok;
+  burst_stats.last_ms=ms;
+  burst_stats.last_fps_x100=ms?(ok*100000UL/ms):0;
+  return ok>0;
+}
+
+void capture_set_timelapse(uint32_t interval_sec){
+  if(interval_sec){
+    if(interval_sec<NORMAL_INTERVAL_MIN_SEC) interval_sec=NORMAL_INTERVAL_MIN_SEC;
+    if(interval_sec>NORMAL_INTERVAL_MAX_SEC) interval_sec=NORMAL_INTERVAL_MAX_SEC;
+  }
+  g_cfg.timelapseSec=interval_sec;
+}
+
+void capture_get_burst_stats(BurstStats& out){ out=burst_stats; }
+
+static bool run_shot(uint8_t trigger){
+  if(g_cfg.burstFrames>1) return capture_burst(trigger,g_cfg.burstFrames,g_cfg.burstIntervalMs);
+  return capture_and_process(trigger);
+}
+
+// 按键中断与采集任务
+static TaskHandle_t capture_task_handle = nullptr;
+static volatile int64_t trigger_us = 0;
+static volatile int64_t trigger_last_us = 0;
+static volatile bool    trigger_pending = false;
+static ShotLatencyStats shot_stats = {};
+static uint64_t shot_total_us_sum = 0;
+static portMUX_TYPE g_trig_mux = portMUX_INITIALIZER_UNLOCKED;  // ISR 与采集任务可能在不同核上同时改 shot_stats
+
+static void IRAM_ATTR button_isr(){
+  int64_t now=esp_timer_get_time();
+  if(now-trigger_last_us < (int64_t)BUTTON_DEBOUNCE_MS*1000) return;
+  trigger_last_us=now;
+  portENTER_CRITICAL_ISR(&g_trig_mux);
+  bool busy=trigger_pending;
+  if(busy) shot_stats.triggers_dropped++;
+  else{ trigger_us=now; trigger_pending=true; }
+  portEXIT_CRITICAL_ISR(&g_trig_mux);
+  if(busy) return;
+  BaseType_t woken=pdFALSE;
+  vTaskNotifyGiveFromISR(capture_task_handle,&woken);
+  if(woken) portYIELD_FROM_ISR();
+}
+
+// 运动检测取帧：不开闪光灯，只解码缩略灰度，帧立即归还
+static bool motion_poll(){
+  if(!camera_ok || !motion_begin()) return false;
+  camera_fb_t *fb=esp_camera_fb_get();
+  if(!fb) return false;
+  bool hit=motion_feed(fb);
+  esp_camera_fb_return(fb);
+  return hit;
+}
+
+static void capture_task(void*){
+  uint32_t next_auto=0;
+  uint32_t next_motion=0;
+  bool auto_armed=false;
+  while(true){
+    // 定时拍：最多等 1s 以便感知 g_cfg.timelapseSec 的变化
+    uint32_t tl=g_cfg.timelapseSec;
+    TickType_t wait=pdMS_TO_TICKS(1000);
+    if(!tl) auto_armed=false;
+    else if(!auto_armed){ next_auto=millis()+tl*1000UL; auto_armed=true; }
+    if(auto_armed){
+      int32_t left=(int32_t)(next_auto-millis());
+      if(left<0) left=0;
+      if((uint32_t)left<1000) wait=pdMS_TO_TICKS(left);
+    }
+    if(g_cfg.motionEnabled){
+      int32_t left=(int32_t)(next_motion-millis());
+      if(left<0) left=0;
+      if(pdMS_TO_TICKS(left)<wait) wait=pdMS_TO_TICKS(left);
+    }
+    if(ulTaskNotifyTake(pdTRUE,wait)==0){
+      if(auto_armed && (int32_t)(millis()-next_auto)>=0){
+        next_auto+=tl*1000UL;
+        if((int32_t)(millis()-next_auto)>=0) next_auto=millis()+tl*1000UL;  // 落后过多则重新对齐
+        run_shot(TRIGGER_AUTO);
+        motion_reset();
+      }
+      if(g_cfg.motionEnabled && (int32_t)(millis()-next_motion)>=0){
+        next_motion=millis()+MOTION_POLL_MS;
+        if(motion_poll()){
+          run_shot(TRIGGER_MOTION);
+          motion_reset();   // 闪光灯改变了曝光，重学背景
+          next_motion=millis()+MOTION_COOLDOWN_MS;
+        }
+      }
+      continue;
+    }
+
+    int64_t t0=trigger_us;
+    shot_frame_us=0;
+    run_shot(TRIGGER_BUTTON);
+    motion_reset();
+    int64_t t1=esp_timer_get_time();
+    uint32_t total=(uint32_t)(t1-t0);
+    portENTER_CRITICAL(&g_trig_mux);
+    trigger_pending=false;
+    shot_stats.shots++;
+    shot_stats.total_us_last=total;
+    if(total>shot_stats.total_us_max) shot_stats.total_us_max=total;
+    shot_total_us_sum+=total;
+    shot_stats.total_us_avg=(uint32_t)(shot_total_us_sum/shot_stats.shots);
+    if(shot_frame_us){
+      uint32_t fr=(uint32_t)(shot_frame_us-t0);
+      shot_stats.frame_us_last=fr;
+      if(fr>shot_stats.frame_us_max) shot_stats.frame_us_max=fr;
+    }
+    portEXIT_CRITICAL(&g_trig_mux);
+  }
+}
+
+bool capture_task_start(){
+  if(capture_task_handle) return true;
+  if(xTaskCreatePinnedToCore(capture_task,"cap",CAPTURE_TASK_STACK,nullptr,
+                             CAPTURE_TASK_PRIO,&capture_task_handle,
+                             CAPTURE_TASK_CORE)!=pdPASS) return false;
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN),button_isr,FALLING);
+  return true;
+}
+
+void capture_get_latency(ShotLatencyStats& out){
+  portENTER_CRITICAL(&g_trig_mux);
+  out=shot_stats;
+  portEXIT_CRITICAL(&g_trig_mux);
+}
+
+// 深睡定时拍：RTC 慢速内存在深睡中保持，序号/剩余空间/摄像头配置都从这里恢复
+struct SleepTlState{
+  uint32_t magic;
+  uint32_t interval_sec;     // 0=已退出
+  uint32_t free_kb;          // 入睡前的剩余空间缓存
+  uint32_t nvs_index;        // 最近写入 NVS 的序号，保持批量写节奏
+  uint32_t awake_ms_sum;
+  SleepCycleStats st;
+};
+static const uint32_t SLEEP_TL_MAGIC=0x534C5450UL;   // "SLTP"
+RTC_NOINIT_ATTR static SleepTlState rtc_sleep_tl;
+
+bool timelapse_sleep_active(){
+  return rtc_sleep_tl.magic==SLEEP_TL_MAGIC && rtc_sleep_tl.interval_sec
+         && esp_sleep_get_wakeup_cause()==ESP_SLEEP_WAKEUP_TIMER;
+}
+
+void timelapse_sleep_stop(){
+  if(rtc_sleep_tl.magic==SLEEP_TL_MAGIC) rtc_sleep_tl.interval_sec=0;
+  rtc_gpio_hold_dis((gpio_num_t)PWDN_GPIO);   // 解除入睡时的摄像头断电保持
+}
+
+bool timelapse_sleep_stats(SleepCycleStats& out){
+  if(rtc_sleep_tl.magic!=SLEEP_TL_MAGIC) return false;
+  out=rtc_sleep_tl.st;
+  return true;
+}
+
+// 扣除本次醒着的时间后入睡；摄像头断电并保持到下次唤醒
+static void sleep_until_next(){
+  rtc_sleep_tl.free_kb=sd_async_free_kb();
+  rtc_sleep_tl.nvs_index=nvs_saved_index;
+  uint64_t awake_us=esp_timer_get_time();
+  uint64_t us=(uint64_t)rtc_sleep_tl.interval_sec*1000000ULL;
+  uint64_t min_us=(uint64_t)SLEEP_TL_MIN_SLEEP_MS*1000ULL;
+  us=(us>awake_us+min_us)?us-awake_us:min_us;
+  esp_sleep_enable_timer_wakeup(us);
+  esp_sleep_enable_ext0_wakeup((gpio_num_t)BUTTON_PIN,0);   // 按键唤醒：退出定时拍，正常启动
+  rtc_gpio_pullup_en((gpio_num_t)BUTTON_PIN);               // 深睡时数字上拉失效
+  rtc_gpio_pulldown_dis((gpio_num_t)BUTTON_PIN);
+  pinMode(PWDN_GPIO,OUTPUT); digitalWrite(PWDN_GPIO,HIGH);
+  rtc_gpio_hold_en((gpio_num_t)PWDN_GPIO);
+  esp_deep_sleep_start();
+}
+
+void timelapse_sleep_enter(uint32_t interval_sec){
+  if(interval_sec<NORMAL_INTERVAL_MIN_SEC) interval_sec=NORMAL_INTERVAL_MIN_SEC;
+  if(interval_sec>NORMAL_INTERVAL_MAX_SEC) interval_sec=NORMAL_INTERVAL_MAX_SEC;
+  if(rtc_sleep_tl.magic!=SLEEP_TL_MAGIC){
+    memset(&rtc_sleep_tl,0,sizeof(rtc_sleep_tl));
+    rtc_sleep_tl.magic=SLEEP_TL_MAGIC;
+  }
+  rtc_sleep_tl.interval_sec=interval_sec;
+  // 写任务排空；超时则跳过仍引用 fb 的段并等到队列清空，再停掉写任务，之后才能释放缓冲和卸卡
+  if(!sd_async_flush()) sd_async_release_fbs();
+  if(camera_ok){ deinit_camera_silent(); camera_ok=false; }
+  sd_async_stop(false);
+  reap_pending_saves();
+  photo_index_persist(true);
+  sd_index_close();
+  SD.end();
+  sleep_until_next();
+}
+
+void timelapse_wake_cycle(){
+  rtc_gpio_hold_dis((gpio_num_t)PWDN_GPIO);
+  SleepCycleStats &st=rtc_sleep_tl.st;
+  bool ok=false;
+  // 序号直接取 RTC，不读 NVS 和索引尾部
+  if(rtc_idx_magic==RTC_IDX_MAGIC) photo_index=rtc_photo_index;
+  nvs_saved_index=rtc_sleep_tl.nvs_index;
+  sdSPI.begin(SD_SCK,SD_MISO,SD_MOSI,SD_CS);
+  if(SD.begin(SD_CS,sdSPI)){
+    sd_index_open();
+    if(rtc_sleep_tl.free_kb && (st.cycles%SLEEP_TL_RECONCILE_CYCLES)!=0) sd_async_seed_free_kb(rtc_sleep_tl.free_kb);
+    else sd_async_on_sd_ready();
+    camera_ok=init_camera_multi();   // RTC 中的上次成功配置优先
+    if(camera_ok){
+      discard_frames(SLEEP_TL_DISCARD);
+      camera_fb_t *fb=esp_camera_fb_get();
+      if(fb){
+        uint32_t index=photo_index;
+        // 同步写：close 即落盘，写完就可以断电
+        if(save_frame_to_sd_raw(fb,index,TRIGGER_AUTO)){
+          photo_index++;
+          photo_index_durable=index;
+          photo_index_persist(false);
+          ok=true;
+        }
+        esp_camera_fb_return(fb);
+      }
+      esp_camera_deinit();
+      camera_ok=false;
+    }
+    sd_index_close();
+    SD.end();
+  }
+  uint32_t ms=(uint32_t)(esp_timer_get_time()/1000);
+  st.cycles++;
+  if(!ok) st.fails++;
+  st.awake_ms_last=ms;
+  if(ms>st.awake_ms_max) st.awake_ms_max=ms;
+  rtc_sleep_tl.awake_ms_sum+=ms;
+  st.awake_ms_avg=rtc_sleep_tl.awake_ms_sum/st.cycles;
+  sleep_until_next();
+}
+
 void wait_button_release_on_boot(){
   pinMode(BUTTON_PIN,INPUT_PULLUP);
   if(digitalRead(BUTTON_PIN)==LOW)
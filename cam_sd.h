@@ -7,6 +7,12 @@
 struct RuntimeConfig{
   bool saveEnabled;
   bool asyncSDWrite;
+  uint32_t timelapseSec;     // 定时拍间隔，0=关闭
+  uint16_t burstFrames;      // 每次触发连拍帧数，1=单拍
+  uint16_t burstIntervalMs;  // 连拍帧间隔，0=按传感器最高帧率
+  bool adaptiveQuality;      // 按写卡反压自动调质量/分辨率（启用时接管这两项）
+  bool uploadEnabled;        // 拍照后经 uplink 上传（需 UPLINK_ENABLE）
+  bool motionEnabled;        // 运动触发（每 MOTION_POLL_MS 检测一次，触发后冷却 MOTION_COOLDOWN_MS）
 };
 
 extern RuntimeConfig g_cfg;
@@ -24,12 +30,104 @@ void deinit_camera_silent();
 bool discard_frames(int n);
 bool reinit_camera_with_params(framesize_t size,int quality);
 
+// 启动：先试 RTC/NVS 中缓存的上次成功配置；摄像头在独立任务中初始化，与 SD 挂载并行
+enum BootPhase : uint8_t {
+  BOOT_SD = 0,        // SD 挂载完成
+  BOOT_INDEX,         // 照片序号恢复完成
+  BOOT_CAM,           // esp_camera_init 完成
+  BOOT_FIRST_FRAME,   // 取到第一帧
+  BOOT_READY,         // setup 结束
+  BOOT_PHASES
+};
+void boot_mark(BootPhase ph);          // 记录自复位起的毫秒数
+void boot_log(Print& out);
+bool camera_init_async();              // 启动初始化任务（含丢弃 DISCARD_FRAMES_ON_START 帧）
+bool camera_init_wait(uint32_t timeout_ms);
+
+// 运行时调参：经 sensor_t 原地修改，不重建驱动；仅当尺寸超过初始化时分配的缓冲才完整重建。
+// 须在采集任务内或采集任务空闲时调用（esp_camera 本身不加锁）
+struct CamParams{
+  framesize_t size;
+  int8_t  quality;     // JPEG 质量 0-63，越小越清晰
+  int16_t aec_value;   // 手动曝光 0-1200，<0 为自动
+  int8_t  agc_gain;    // 手动增益 0-30，<0 为自动
+};
+struct CamSwitchStats{
+  uint32_t live;           // 原地切换次数
+  uint32_t full;           // 完整重建次数
+  uint32_t fail;
+  uint32_t live_us_last;   // 调用 -> 取到新尺寸首帧
+  uint32_t live_us_max;
+  uint32_t full_us_last;
+  uint32_t full_us_max;
+};
+bool camera_set_params(const CamParams& p);
+void camera_get_params(CamParams& out);
+void camera_get_switch_stats(CamSwitchStats& out);
+
 // SD卡与异步写（保留）
 void init_sd();
 void periodic_sd_check();
 
+// 图片序号持久化：RTC 内存每张更新，NVS 按 SAVE_PARAMS_INTERVAL_IMAGES /
+// NVS_MIN_SAVE_INTERVAL_MS 批量写；启动时取 RTC、NVS、索引尾部三者最大值
+void photo_index_restore();   // init_sd() 之后调用
+uint32_t photo_index_next();
+
 // 拍照处理（只保存到SD）
 bool capture_and_process(uint8_t trigger);
 
+// 按键中断触发 + 独立采集任务（固定在 CAPTURE_TASK_CORE）
+struct ShotLatencyStats{
+  uint32_t shots;
+  uint32_t triggers_dropped;   // 上一张未完成时到来的触发
+  uint32_t frame_us_last;      // 触发 -> 取到帧
+  uint32_t frame_us_max;
+  uint32_t total_us_last;      // 触发 -> 提交保存完成
+  uint32_t total_us_max;
+  uint32_t total_us_avg;
+};
+bool capture_task_start();
+void capture_get_latency(ShotLatencyStats& out);
+
+// 连拍/定时拍：闪光灯整段常亮，取帧与写卡流水并行
+struct BurstStats{
+  uint32_t bursts;
+  uint32_t frames_ok;        // 累计提交成功帧数
+  uint32_t frames_dropped;   // 累计丢帧（取帧失败或写队列满）
+  uint32_t last_frames;      // 最近一次连拍成功帧数
+  uint32_t last_fps_x100;    // 最近一次实际帧率 ×100
+  uint32_t last_ms;
+};
+bool capture_burst(uint8_t trigger,uint16_t frames,uint32_t interval_ms);
+void capture_set_timelapse(uint32_t interval_sec);   // 按 NORMAL_INTERVAL_* 限幅，0=关闭
+void capture_get_burst_stats(BurstStats& out);
+
+struct AdaptStats{
+  uint8_t  level;            // 0=PREF 质量与尺寸，越大越省带宽
+  uint8_t  levels;
+  uint32_t steps_down;
+  uint32_t steps_up;
+  uint32_t occ_pct;          // 最近窗口：队列/环形区占用较大者
+  uint32_t util_pct;         // 最近窗口：提交字节率 / 写卡吞吐
+  uint32_t write_kBps;       // 写任务忙碌时的实测吞吐
+};
+void capture_get_adapt_stats(AdaptStats& out);
+
+// 深睡定时拍：照片序号、剩余空间、摄像头配置留在 RTC 内存；按键唤醒退出该模式
+struct SleepCycleStats{
+  uint32_t cycles;
+  uint32_t fails;            // 挂卡/起摄像头/取帧/写盘任一步失败
+  uint32_t awake_ms_last;    // 唤醒 -> 再次入睡（不含 ROM 引导）
+  uint32_t awake_ms_max;
+  uint32_t awake_ms_avg;
+};
+bool timelapse_sleep_active();                    // 本次为定时唤醒且处于深睡定时拍
+// 不返回。须在 setup 中、启动采集/保留/协议等后台任务之前调用：入睡前只需排空写任务
+void timelapse_sleep_enter(uint32_t interval_sec);
+void timelapse_wake_cycle();                      // 唤醒快速路径，不返回
+void timelapse_sleep_stop();
+bool timelapse_sleep_stats(SleepCycleStats& out);    // 无有效记录返回 false
+
 // 按键启动时等待释放（保留）
 void wait_button_release_on_boot();
\ No newline at end of file
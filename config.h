@@ -7,16 +7,18 @@
 #define ASYNC_SD_ENABLE 1
 #endif
 
-#ifndef ASYNC_SD_POOL_BLOCK_SIZE
-#define ASYNC_SD_POOL_BLOCK_SIZE (256 * 1024)
+// 变长环形区：帧首尾相接存放，30~60KB 的 SVGA JPEG 可同时缓存 10~20 帧
+#ifndef ASYNC_SD_ARENA_SIZE
+#define ASYNC_SD_ARENA_SIZE (768 * 1024)
 #endif
 
-#ifndef ASYNC_SD_POOL_BLOCKS
-#define ASYNC_SD_POOL_BLOCKS 3
+// 单次预留上限；更大的缓冲按此切块（须为 512 的倍数）
+#ifndef ASYNC_SD_MAX_CHUNK
+#define ASYNC_SD_MAX_CHUNK (128 * 1024)
 #endif
 
 #ifndef ASYNC_SD_QUEUE_LENGTH
-#define ASYNC_SD_QUEUE_LENGTH 8
+#define ASYNC_SD_QUEUE_LENGTH 32   // 须为 2 的幂；与环形区容量匹配，可排队 10~20 帧
 #endif
 
 #ifndef ASYNC_SD_TASK_STACK
@@ -27,6 +29,11 @@
 #define ASYNC_SD_TASK_PRIO 3
 #endif
 
+// 写任务与采集任务分核运行
+#ifndef ASYNC_SD_TASK_CORE
+#define ASYNC_SD_TASK_CORE 0
+#endif
+
 #ifndef ASYNC_SD_MAX_PATH
 #define ASYNC_SD_MAX_PATH 96
 #endif
@@ -38,6 +45,73 @@
 #ifndef ASYNC_SD_FLUSH_TIMEOUT_MS
 #define ASYNC_SD_FLUSH_TIMEOUT_MS 5000
 #endif
+
+// 剩余空间缓存：按簇向上取整记账，定期与文件系统对账
+#ifndef ASYNC_SD_SPACE_ALLOC_UNIT
+#define ASYNC_SD_SPACE_ALLOC_UNIT (32 * 1024)
+#endif
+
+#ifndef ASYNC_SD_SPACE_RECONCILE_MS
+#define ASYNC_SD_SPACE_RECONCILE_MS (5UL * 60UL * 1000UL)
+#endif
+
+// 分桶目录与仅追加索引
+#ifndef SD_INDEX_DIR
+#define SD_INDEX_DIR    "/img"
+#endif
+#define SD_INDEX_FILE   SD_INDEX_DIR "/photo.idx"
+#ifndef SD_INDEX_BUCKET
+#define SD_INDEX_BUCKET 1000
+#endif
+#define SD_INDEX_MAGIC  0x58444950UL   // "PIDX"
+
+// 可查询写入结果的最近凭据数（须为 2 的幂）
+#ifndef ASYNC_SD_RESULT_SLOTS
+#define ASYNC_SD_RESULT_SLOTS 64
+#endif
+
+// 写会话空闲超时：未收到 JOB_CLOSE 时写任务自动关闭文件
+#ifndef ASYNC_SD_SESSION_IDLE_MS
+#define ASYNC_SD_SESSION_IDLE_MS 1000
+#endif
+
+// 帧缓冲数（PSRAM 时生效）；>1 时写任务持有帧期间采集不阻塞
+#ifndef CAMERA_FB_COUNT
+#define CAMERA_FB_COUNT 2
+#endif
+
+// 输出模式：0=每张图片一个文件，1=顺序追加进段容器文件（见 sd_segment.h），2=循环槽文件
+#ifndef ASYNC_SD_OUTPUT_MODE
+#define ASYNC_SD_OUTPUT_MODE 0
+#endif
+#ifndef SD_SEGMENT_DIR
+#define SD_SEGMENT_DIR         "/seg"
+#endif
+#define SD_SEGMENT_MAX_BYTES   (8UL * 1024UL * 1024UL)   // 段文件大小（预分配）
+#define SD_SEGMENT_MAX_FRAMES  1024                      // 单段帧数上限（尾部索引表容量）
+#define SD_SEGMENT_MAX_MS      (10UL * 60UL * 1000UL)    // 段最长保持打开时间
+#define SD_SEGMENT_ALIGN       512                       // 帧记录按扇区对齐
+#define SD_SEGMENT_SYNC_FRAMES 16                        // 每写这么多帧刷新一次目录项
+#define SD_SEGMENT_PREALLOC    1
+#define SD_SEG_FRAME_MAGIC     0x314D5246UL   // "FRM1"
+#define SD_SEG_FOOTER_MAGIC    0x58444953UL   // "SIDX"
+
+// 循环录制（输出模式 2）：定长槽文件原地覆盖，见 sd_ring.h
+#ifndef SD_RING_DIR
+#define SD_RING_DIR            "/ring"
+#endif
+#ifndef SD_RING_SLOTS
+#define SD_RING_SLOTS          512
+#endif
+#ifndef SD_RING_SLOT_BYTES
+#define SD_RING_SLOT_BYTES     (256UL * 1024UL)          // 须容纳最大帧 + 槽头
+#endif
+#define SD_RING_DATA_OFF       512                       // 数据起始偏移（扇区对齐）
+#define SD_RING_MOUNT_SLOTS    4                         // 挂载时至多同步新建的槽，其余由写任务空闲时补建
+#define SD_RING_GROW_RETRY_MS  (60UL * 1000UL)           // 补建因空间不足/写失败停下后的重试间隔
+#define SD_RING_MOUNT_BACKOFF_MS     2000                // 挂载失败后 sd_ring_begin 不再重试的时长，逐次翻倍
+#define SD_RING_MOUNT_BACKOFF_MAX_MS (60UL * 1000UL)
+#define SD_RING_MAGIC          0x474E4952UL   // "RING"
 // ===== 异步SD写与内存池 END =====
 
 // === 开关 ===
@@ -61,15 +135,22 @@
 #define ENABLE_AUTO_REINIT             1
 #define ENABLE_STATS_LOG               1
 #define ENABLE_FRAME_HEADER            0
+#define FRAME_HDR_APP_MARKER           0xE9          // APP9 段携带拍摄信息，解码器会跳过
+#define FRAME_TRAILER_MAGIC            0x31435246UL  // "FRC1"：EOI 之后的 CRC 尾
 #define ENABLE_ASYNC_SD_WRITE          0
 #define SAVE_PARAMS_INTERVAL_IMAGES    50
 #define DEFAULT_SEND_BEFORE_SAVE       1
 #define FLASH_MODE                     1
-#define FLASH_WARM_MS                  60
-#define FLASH_ON_TIME_MS_DIGITAL       40
+#define FLASH_SETTLE_MAX_MS            300   // 开灯后等待曝光收敛的上限
+#define FLASH_SETTLE_PCT               8     // 相邻两帧 JPEG 大小变化 <= 此百分比视为收敛
+#define FLASH_SETTLE_MIN_FRAMES        2     // 至少取这么多帧（首帧多为开灯前曝光）
 #define HEAP_WARN_THRESHOLD            16000
 #define HEAP_LARGEST_BLOCK_WARN        12000
 static constexpr uint32_t NVS_MIN_SAVE_INTERVAL_MS = 60UL * 1000UL;
+static const char* NVS_NS_CAM          = "camsd";
+static const char* NVS_KEY_PHOTO_IDX   = "photo_idx";
+static const char* NVS_KEY_CAM_GOOD    = "cam_good";   // 上次成功的摄像头配置
+#define SD_INDEX_TAIL_SCAN             8     // 启动时只读索引尾部这么多条
 
 #define CR_OK                0
 #define CR_CAMERA_NOT_READY  1
@@ -93,6 +174,17 @@ static constexpr uint32_t NVS_MIN_SAVE_INTERVAL_MS = 60UL * 1000UL;
 #define OTA_FOOTER_MAX_SIZE 384      // 足够容纳 P-256 ECDSA DER 签名的 Footer
 #endif
 
+// 窗口化断点续传：多个块请求在途，按位图块整扇区擦写，位图存 NVS，重启后只补缺失的位图块
+#ifndef OTA_ENABLE
+#define OTA_ENABLE 0                 // 经协议链路接收升级（需 UPGRADE_ENABLE）
+#endif
+#define OTA_WINDOW            8      // 同时在途的 CMD_FILE_BLOCK_REQ
+#define OTA_STAGE_REGIONS     3      // 暂存位图块数，须 >= 窗口跨越的位图块数 + 1
+#define OTA_SAVE_EVERY        16     // 每写完这么多位图块保存一次位图
+#define OTA_TASK_STACK        4096
+#define OTA_TASK_PRIO         2
+#define OTA_TASK_CORE         0
+
 // === 引脚 ===
 #define PWDN_GPIO 32
 #define RESET_GPIO -1
@@ -129,6 +221,49 @@ static constexpr uint32_t NVS_MIN_SAVE_INTERVAL_MS = 60UL * 1000UL;
 
 // Button
 #define BUTTON_PIN 12
+#define BUTTON_DEBOUNCE_MS 30
+
+// 采集任务：按键中断唤醒，高优先级独占一个核
+#define CAPTURE_TASK_STACK 4096
+#define CAPTURE_TASK_PRIO  5
+#define CAPTURE_TASK_CORE  1
+#define CAM_INIT_TASK_STACK 4096   // 启动时摄像头与 SD 挂载并行初始化
+#define CAM_INIT_WAIT_MS    5000
+
+// 深睡定时拍：两次拍照之间深睡，唤醒后只走 挂卡 -> 起摄像头 -> 一帧 -> 写盘 -> 睡
+#define SLEEP_TL_SEC_DEFAULT       0     // 非 0：启动后直接进入深睡定时拍（按 NORMAL_INTERVAL_* 限幅）
+#define SLEEP_TL_DISCARD           2     // 唤醒后丢弃的帧数（等自动曝光收敛）
+#define SLEEP_TL_RECONCILE_CYCLES  100   // 每这么多次唤醒完整统计一次剩余空间
+#define SLEEP_TL_MIN_SLEEP_MS      200
+
+// 连拍默认参数（运行时可在 g_cfg 中修改）
+#define BURST_FRAMES_DEFAULT       1
+#define BURST_INTERVAL_MS_DEFAULT  0
+#define BURST_FRAMES_MAX           200
+
+// 反压自适应：写队列/环形区占用或写卡带宽利用率过高时先降 JPEG 质量再降分辨率，
+// 在 *_PREF 与 *_FALLBACK 之间分级；持续低负载 ADAPT_UP_HOLD_MS 后逐级恢复
+#define ADAPT_ENABLE           1
+#define ADAPT_WINDOW_MS        500
+#define ADAPT_Q_STEP           2
+#define ADAPT_HIGH_PCT         60    // 占用 >= 此值降一级
+#define ADAPT_LOW_PCT          20    // 占用 <= 此值才考虑恢复
+#define ADAPT_UTIL_HIGH_PCT    90    // 提交字节率 / 写卡吞吐
+#define ADAPT_UTIL_LOW_PCT     50
+#define ADAPT_UP_HOLD_MS       5000
+
+// 保留策略：低优先级后台任务按索引从最旧开始删除；各上限为 0 表示不启用该项
+#define RETAIN_ENABLE          1
+#define RETAIN_MAX_MB          0
+#define RETAIN_MAX_DAYS        0
+#define RETAIN_MAX_FILES       0
+#define RETAIN_FREE_MARGIN_MB  64    // 剩余空间低于 SD_MIN_FREE_MB + 此值即开始删除
+#define RETAIN_BATCH           8     // 每轮最多删除文件数
+#define RETAIN_SLICE_MS        20    // 两次删除之间让出的时间
+#define RETAIN_POLL_MS         2000
+#define RETAIN_TASK_STACK      4096
+#define RETAIN_TASK_PRIO       1     // 低于写任务，只在写任务空闲时删除
+#define RETAIN_TASK_CORE       0
 
 // === 平台协议版本/型号 ===
 #define PLATFORM_VER        0x5B
@@ -151,6 +286,7 @@ static constexpr uint32_t NVS_MIN_SAVE_INTERVAL_MS = 60UL * 1000UL;
 #define CMD_REMOTE_UPGRADE_CMD  0x8005
 #define CMD_REMOTE_FUNCTION_CMD 0x8006
 #define CMD_S_GET_IMAGE         0x8015
+#define CMD_S_GET_STATS         0x80F0  // 调试统计：payload 1 字节 's'/'b'/'r'，同串口命令
 // 图片上传
 #define CMD_IMAGE_UPLOAD        0x1F00
 
@@ -170,6 +306,25 @@ static const uint32_t WORK_INTERVAL_MAX_SEC   = 24UL*3600UL;
 #define TRIGGER_AUTO   0
 #define TRIGGER_BUTTON 1
 #define TRIGGER_REMOTE 2
+#define TRIGGER_MOTION 3
+
+// 运动触发：定期取一帧按 1/8 解码成灰度，与滑动背景逐块求 SAD，变化块足够多才拍全分辨率
+#ifndef MOTION_ENABLE
+#define MOTION_ENABLE          0
+#endif
+#define MOTION_POLL_MS         500
+#define MOTION_COOLDOWN_MS     3000   // 触发后至少间隔
+#define MOTION_BLOCK           8      // 块边长（缩小后的像素），须为 4 的倍数
+#define MOTION_PIX_DIFF        12     // 块内平均绝对差超过此值视为变化块
+#define MOTION_MIN_BLOCKS      3
+#define MOTION_MAX_BLOCKS_PCT  60     // 变化块占比超过此值视为整体亮度变化，重学背景
+#define MOTION_BG_SHIFT        3      // 未变化块的背景更新速率 1/2^n
+#define MOTION_ABSORB_POLLS    20     // 连续变化这么多次的块直接并入背景（停下的车、挪动的物体）
+#define MOTION_MAX_W           200    // UXGA / 8
+#define MOTION_MAX_H           150
+#ifndef MOTION_SWAR
+#define MOTION_SWAR            1      // 一次处理 4 像素；0=逐像素（make test 两种都跑）
+#endif
 
 // 主动图片上传
 #define IMAGE_MAX_LEN            65000
@@ -180,6 +335,36 @@ static const uint32_t WORK_INTERVAL_MAX_SEC   = 24UL*3600UL;
 #define PLATFORM_SLAVE_ID        0x00000001
 #define GET_IMAGE_MAX_LEN        65000
 
+// 协议收发：接收环原地解帧，独立任务按预算读串口/TCP
+#define PROTO_RX_RING            4096   // 2 的幂，至少容纳两帧最大帧
+#define PROTO_MAX_PAYLOAD        1536   // 超过视为坏头，重新找同步
+#define PROTO_RX_BUDGET          512    // 每轮最多读取字节，读满即让出一个 tick
+#define PROTO_RX_IDLE_MS         5
+#define PROTO_RX_STALL_MS        300    // 环里停着半帧且这么久没有新字节：丢一个字节重新找同步（防坏头长度卡住解析）
+#define PROTO_MAX_HANDLERS       8
+#define PROTO_STATS_CHUNK        256    // CMD_S_GET_STATS 回复每帧字节，空帧表示结束
+#define PROTO_TASK_STACK         4096
+#define PROTO_TASK_PRIO          2
+#define PROTO_TASK_CORE          0
+
+// 图片上传管线：与写卡共享帧缓冲，滑动窗口选择重传，令牌桶按 PROTO_MIN_SEND_INTERVAL_MS 节流
+#ifndef UPLINK_ENABLE
+#define UPLINK_ENABLE            0
+#endif
+#define UPLINK_PKT_PAYLOAD       1024   // 每包数据字节（另加 IMAGE_META_LEN 字节包头）
+#define UPLINK_WINDOW            8      // 未确认包上限
+#define UPLINK_RTO_MS            800    // 单包重传超时
+#ifndef UPLINK_BURST
+#define UPLINK_BURST             1      // 令牌桶容量（包）：1 时相邻两包间隔不小于 PROTO_MIN_SEND_INTERVAL_MS；
+                                        // 大于 1 时空闲后可连发这么多包，该间隔只在平均意义上成立
+#endif
+#define UPLINK_QUEUE_LEN         1      // 在途帧数（含正在发送）；每帧占住一个驱动缓冲，须小于 CAMERA_FB_COUNT
+#define UPLINK_TASK_STACK        4096
+#define UPLINK_TASK_PRIO         2      // 低于写任务
+#define UPLINK_TASK_CORE         0
+
+#define PROTO_LINK_ENABLE        (UPLINK_ENABLE || OTA_ENABLE)
+
 // 升级常量
 #if UPGRADE_ENABLE
 static const uint32_t UPG_BLOCK_RESP_TIMEOUT  = 5000;
@@ -190,11 +375,13 @@ static uint32_t UPG_MAX_TOTAL_SIZE            = 8*1024*1024; // 动态修正
 static const uint32_t UPG_INFO_RESP_TIMEOUT   = 5000;
 static const uint32_t UPG_BLOCK_SIZE          = 1024;
 
+static const char* NVS_NS_UP         = "upgrade";
 static const char* NVS_KEY_UP_STATE  = "up_state";
 static const char* NVS_KEY_UP_TOTAL  = "up_total";
 static const char* NVS_KEY_UP_RECV   = "up_recv";
 static const char* NVS_KEY_UP_MD5HEX = "up_md5";
 static const char* NVS_KEY_UP_BLKSZ  = "up_blksz";
+static const char* NVS_KEY_UP_BITMAP = "up_bmp";
 #endif
 
 // 地址结构
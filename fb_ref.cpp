@@ -0,0 +1,43 @@
+#include "fb_ref.h"
+#include "config.h"
+#include <freertos/FreeRTOS.h>
+
+// 同时在途的帧不超过驱动缓冲数
+struct FbRef{ camera_fb_t* fb; uint8_t refs; };
+static FbRef g_refs[CAMERA_FB_COUNT + 1];
+static portMUX_TYPE g_ref_mux = portMUX_INITIALIZER_UNLOCKED;
+
+bool fb_ref_begin(camera_fb_t* fb){
+  if(!fb) return false;
+  bool ok = false;
+  portENTER_CRITICAL(&g_ref_mux);
+  for(auto& r : g_refs){
+    if(r.fb) continue;
+    r.fb = fb; r.refs = 1; ok = true;
+    break;
+  }
+  portEXIT_CRITICAL(&g_ref_mux);
+  return ok;
+}
+
+bool fb_ref_add(camera_fb_t* fb){
+  bool ok = false;
+  portENTER_CRITICAL(&g_ref_mux);
+  for(auto& r : g_refs) if(r.fb == fb){ r.refs++; ok = true; break; }
+  portEXIT_CRITICAL(&g_ref_mux);
+  return ok;
+}
+
+void fb_ref_release(camera_fb_t* fb){
+  if(!fb) return;
+  bool last = true;   // 未登记：唯一使用者
+  portENTER_CRITICAL(&g_ref_mux);
+  for(auto& r : g_refs){
+    if(r.fb != fb) continue;
+    last = (--r.refs == 0);
+    if(last) r.fb = nullptr;
+    break;
+  }
+  portEXIT_CRITICAL(&g_ref_mux);
+  if(last) esp_camera_fb_return(fb);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// 帧缓冲引用计数：同一帧同时交给写卡与上传时，两边各持一份引用，
+// 最后一个释放者归还驱动，JPEG 不再拷贝。
+// 未登记的帧 release 即直接归还，单一使用者的旧路径不受影响。
+
+// 登记 fb，调用方持有第一份引用；表满返回 false（此时只能单一使用者）
+bool fb_ref_begin(camera_fb_t* fb);
+// 交给下一个使用者前加一份引用；未登记返回 false（交接失败时也不要 release）
+bool fb_ref_add(camera_fb_t* fb);
+// 释放一份引用，归零时 esp_camera_fb_return()
+void fb_ref_release(camera_fb_t* fb);
\ No newline at end of file
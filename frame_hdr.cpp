@@ -0,0 +1,40 @@
+#include "frame_hdr.h"
+#include "cam_sd.h"
+
+uint8_t frame_hdr_iov(const camera_fb_t* fb, const SdFileMeta& m, FrameHdr& h, SdIov* iov){
+  iov[0].data = fb->buf;
+  iov[0].len = fb->len;
+#if ENABLE_FRAME_HEADER
+  if(fb->len < 4 || fb->buf[0] != 0xFF || fb->buf[1] != 0xD8) return 1;
+  CamParams p;
+  camera_get_params(p);
+  memset(&h, 0, sizeof(h));
+  h.marker[0] = 0xFF;
+  h.marker[1] = FRAME_HDR_APP_MARKER;
+  uint16_t seg = sizeof(h) - 2;
+  h.seg_len[0] = seg >> 8;
+  h.seg_len[1] = seg & 0xFF;
+  memcpy(h.id, "CAMH", 4);
+  h.ver = 1;
+  h.trigger = m.trigger;
+  h.index = m.index;
+  h.ts = m.ts;
+  h.width = fb->width;
+  h.height = fb->height;
+  h.framesize = p.size;
+  h.quality = p.quality;
+  h.aec_value = p.aec_value;
+  h.agc_gain = p.agc_gain;
+  h.flags = 0x01;
+  h.jpeg_len = fb->len;
+  iov[0].len = 2;
+  iov[1].data = (const uint8_t*)&h;
+  iov[1].len = sizeof(h);
+  iov[2].data = fb->buf + 2;
+  iov[2].len = fb->len - 2;
+  return 3;
+#else
+  (void)m; (void)h;
+  return 1;
+#endif
+}
\ No newline at end of file
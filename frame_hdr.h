@@ -0,0 +1,38 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "config.h"
+#include "sd_async.h"
+
+// 帧内元数据（ENABLE_FRAME_HEADER）：紧跟 SOI 插入一个 APPn 段，文件末尾追加 CRC 尾。
+//   FF D8 | FrameHdr（FF E9 段）| 原 JPEG 其余部分 | FrameTrailer
+// 入库时读固定偏移的头即可拿到序号/时间/参数，读最后 8 字节校验整文件，无需解析 EXIF。
+// 多字节字段小端（段长度按 JPEG 规定为大端）。
+
+#pragma pack(push,1)
+struct FrameHdr{
+  uint8_t  marker[2];   // FF FRAME_HDR_APP_MARKER
+  uint8_t  seg_len[2];  // 大端，含自身 2 字节，不含 marker
+  char     id[4];       // "CAMH"
+  uint8_t  ver;
+  uint8_t  trigger;
+  uint32_t index;
+  uint32_t ts;
+  uint16_t width;
+  uint16_t height;
+  uint8_t  framesize;
+  int8_t   quality;
+  int16_t  aec_value;   // <0 自动
+  int8_t   agc_gain;    // <0 自动
+  uint8_t  flags;       // bit0：文件末尾带 FrameTrailer
+  uint32_t jpeg_len;    // 原 JPEG 字节数
+};
+struct FrameTrailer{
+  uint32_t crc;         // 文件中本结构之前全部字节的 CRC32
+  uint32_t magic;       // FRAME_TRAILER_MAGIC
+};
+#pragma pack(pop)
+
+// 拆成 [SOI][头][其余] 三段写入，JPEG 本身不拷贝。未启用或 fb 不是 JPEG 时返回原样一段。
+// 返回段数；> 1 时应带 SD_SUBMIT_CRC_TRAILER 提交
+uint8_t frame_hdr_iov(const camera_fb_t* fb, const SdFileMeta& m, FrameHdr& h, SdIov* iov);
\ No newline at end of file
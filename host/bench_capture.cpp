@@ -0,0 +1,310 @@
+// 保存路径基准：假传感器 + 仿真 SD，分别跑同步与异步保存，
+// 报告拍照速率、单张耗时与提交耗时分位、写队列深度与环形区占用。
+// -m submit：写任务饱和时背靠背提交，比较旧实现（互斥锁环形区 + xQueue 拷贝作业）与现行无锁环的提交耗时
+#include "cam_sd.h"
+#include "sd_async.h"
+#include "perf_stats.h"
+#include "shim/sim.h"
+#include <SD.h>
+#include <esp_camera.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <unistd.h>
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Profile{ const char* name; SimSdProfile p; };
+// 时间量级取自 SPI 模式 Class 10 卡实测：单次写 ~1.4 MB/s，建文件/关闭各数毫秒
+static const Profile PROFILES[] = {
+  { "fast",   { 1500, 2500, 100,  400, 1000, 1500, 0,  0,     0, 32ull << 30 } },
+  { "class10",{ 3000, 5000, 200,  700, 2000, 3000, 2048, 40000, 0, 32ull << 30 } },
+  { "slow",   { 8000, 15000, 500, 2000, 5000, 8000, 512, 120000, 0, 8ull << 30 } },
+  { "flaky",  { 3000, 5000, 200,  700, 2000, 3000, 2048, 40000, 40, 32ull << 30 } },
+};
+
+struct Opt{
+  int shots = 60;
+  uint32_t interval_ms = 0;   // 两次触发的间隔，0=背靠背
+  uint32_t frame_us = 40000;
+  const char* profile = "class10";
+  const char* mode = "both";
+  const char* jpeg_dir = nullptr;
+  SdOutputMode out = SD_OUT_FILES;
+};
+
+static void usage(){
+  fprintf(stderr,
+    "usage: bench_capture [-n shots] [-i interval_ms] [-f frame_us] [-p fast|class10|slow|flaky]\n"
+    "                     [-m sync|async|both|submit] [-o files|segment|ring] [-j jpeg_dir]\n");
+  exit(2);
+}
+
+static uint32_t pct_of(std::vector<uint32_t> v, int pct){
+  if(v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t i = (v.size() * pct + 99) / 100;
+  return v[i ? i - 1 : 0];
+}
+
+// 合成 SVGA 场景：亮度逐帧小幅变化，模拟开灯后曝光收敛
+static void make_frames(){
+  std::vector<uint8_t> g, j;
+  for(int k = 0; k < 8; k++){
+    sim_scene_gray(g, 800, 600, k, 100 + k * 40, 200, 120, 160, 96 + k % 3 * 2);
+    sim_jpeg_encode_gray(g.data(), 800, 600, 85, j);
+    sim_sensor_add_frame(j.data(), j.size());
+  }
+}
+
+struct Sampler{
+  std::atomic<bool> run{ true };
+  uint64_t n = 0, q_sum = 0, pool_sum = 0;
+  uint32_t q_max = 0, pool_max = 0;
+  void loop(){
+    while(run){
+      SdAsyncStats st;
+      sd_async_get_stats(st);
+      uint32_t used = st.pool_total ? (st.pool_total - st.pool_free) * 100 / st.pool_total : 0;
+      n++; q_sum += st.q_depth; pool_sum += used;
+      q_max = std::max(q_max, st.q_depth); pool_max = std::max(pool_max, used);
+      usleep(1000);
+    }
+  }
+};
+
+static void run(bool async, const Opt& o){
+  g_cfg.asyncSDWrite = async;
+  g_cfg.adaptiveQuality = false;   // 固定画质，两种路径可比
+  sd_async_flush();
+  perf_reset();
+  SimSdStats sd0, sd1;
+  sim_sd_get_stats(sd0);
+  SdAsyncStats a0, a1;
+  sd_async_get_stats(a0);
+
+  Sampler smp;
+  std::thread th([&]{ smp.loop(); });
+  std::vector<uint32_t> lat;
+  uint32_t ok = 0;
+  int64_t t0 = esp_timer_get_time();
+  for(int i = 0; i < o.shots; i++){
+    int64_t s = esp_timer_get_time();
+    if(capture_and_process(TRIGGER_BUTTON)) ok++;
+    lat.push_back((uint32_t)(esp_timer_get_time() - s));
+    if(o.interval_ms) delay(o.interval_ms);
+  }
+  int64_t t_submit = esp_timer_get_time() - t0;
+  bool drained = sd_async_flush();
+  int64_t t_all = esp_timer_get_time() - t0;
+  smp.run = false;
+  th.join();
+  sim_sd_get_stats(sd1);
+  sd_async_get_stats(a1);
+  PerfHist sub;
+  perf_get(PS_SUBMIT, sub);
+
+  printf("\n== %s save, %d shots ==\n", async ? "async" : "sync", o.shots);
+  printf("shots/s      : %.2f (capture loop)  %.2f (incl. drain%s)\n",
+         ok * 1e6 / t_submit, ok * 1e6 / t_all, drained ? "" : ", TIMEOUT");
+  printf("ok/failed    : %u/%u  write_fail=%u\n", ok, o.shots - ok, a1.write_fail - a0.write_fail);
+  printf("shot ms      : p50=%.1f p90=%.1f p99=%.1f max=%.1f\n", pct_of(lat, 50) / 1e3,
+         pct_of(lat, 90) / 1e3, pct_of(lat, 99) / 1e3, pct_of(lat, 100) / 1e3);
+  // 写任务忙碌时间（含建文件/关闭）折算的写卡能力，不受取帧速率限制
+  uint32_t busy_ms = a1.write_ms - a0.write_ms;
+  if(async && busy_ms)
+    printf("writer       : busy=%u ms  %.1f frames/s  %.2f MB/s\n", busy_ms, ok * 1e3 / busy_ms,
+           (a1.bytes_written - a0.bytes_written) / 1048.576 / busy_ms);
+  printf("submit us    : p50<=%u p90<=%u p99<=%u max=%u (n=%u)\n", perf_percentile(sub, 50),
+         perf_percentile(sub, 90), perf_percentile(sub, 99), sub.max, sub.count);
+  printf("queue depth  : avg=%.2f max=%u (q_max since boot %u/%u)\n",
+         smp.n ? (double)smp.q_sum / smp.n : 0.0, smp.q_max, a1.q_max, ASYNC_SD_QUEUE_LENGTH);
+  printf("pool occupied: avg=%.1f%% max=%u%% hwm=%u KB of %u KB, wraps=%u\n",
+         smp.n ? (double)smp.pool_sum / smp.n : 0.0, smp.pool_max, a1.pool_hwm / 1024,
+         a1.pool_total / 1024, a1.pool_wraps - a0.pool_wraps);
+  printf("sd           : opens=%u writes=%u injected_fail=%u MB=%.2f open_files=%u\n",
+         sd1.opens - sd0.opens, sd1.writes - sd0.writes, sd1.write_fail - sd0.write_fail,
+         (sd1.bytes - sd0.bytes) / 1048576.0, sd1.open_files);
+}
+
+// ---- 旧写入路径的复刻（按块拷贝进互斥锁保护的环形区，作业经 xQueue 按值传递），只作对照 ----
+namespace legacy{
+struct Job{ uint8_t op; char path[ASYNC_SD_MAX_PATH]; uint8_t* data; uint32_t len, span; bool is_first; };
+static SemaphoreHandle_t mtx;
+static QueueHandle_t q;
+static uint8_t* arena;
+static uint32_t arena_off, arena_in, arena_out;
+static std::atomic<bool> running;
+
+static bool pool_take(uint32_t len, Job& j){
+  uint32_t need = (len + 3) & ~3u;
+  bool ok = false;
+  xSemaphoreTake(mtx, portMAX_DELAY);
+  uint32_t used = arena_in - arena_out, off = arena_off;
+  uint32_t pad = (off + need > ASYNC_SD_ARENA_SIZE) ? ASYNC_SD_ARENA_SIZE - off : 0;
+  if(used + pad + need <= ASYNC_SD_ARENA_SIZE){
+    if(pad) off = 0;
+    j.data = arena + off; j.len = len; j.span = pad + need;
+    arena_off = off + need;
+    if(arena_off >= ASYNC_SD_ARENA_SIZE) arena_off = 0;
+    arena_in += j.span;
+    ok = true;
+  }
+  xSemaphoreGive(mtx);
+  return ok;
+}
+
+static void pool_give(const Job& j){
+  xSemaphoreTake(mtx, portMAX_DELAY);
+  arena_out += j.span;
+  xSemaphoreGive(mtx);
+}
+
+static void writer(){
+  File f;
+  Job j;
+  while(running || uxQueueMessagesWaiting(q)){
+    if(xQueueReceive(q, &j, pdMS_TO_TICKS(100)) != pdTRUE) continue;
+    if(j.is_first){ if(f) f.close(); f = SD.open(j.path, FILE_WRITE); }
+    if(f) f.write(j.data, j.len);
+    if(j.op == 1 && f) f.close();
+    pool_give(j);
+  }
+}
+
+// 环形区满时睡一个超时周期再试一次，入队按超时等待
+static bool submit(const char* path, const uint8_t* data, size_t len, uint32_t timeout_ms){
+  bool first = true;
+  for(size_t off = 0; off < len; ){
+    size_t chunk = std::min<size_t>(len - off, ASYNC_SD_MAX_CHUNK);
+    Job j{};
+    if(!pool_take(chunk, j)){
+      vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+      if(!pool_take(chunk, j)) return false;
+    }
+    memcpy(j.data, data + off, chunk);
+    j.op = off + chunk == len ? 1 : 0;
+    snprintf(j.path, sizeof(j.path), "%s", path);
+    j.is_first = first;
+    first = false;
+    if(xQueueSend(q, &j, pdMS_TO_TICKS(timeout_ms)) != pdTRUE){
+      xSemaphoreTake(mtx, portMAX_DELAY);
+      arena_in -= j.span;
+      arena_off = (uint32_t)(j.data - arena);
+      xSemaphoreGive(mtx);
+      return false;
+    }
+    off += chunk;
+  }
+  return true;
+}
+}
+
+static void print_submit(const char* name, std::vector<uint32_t>& lat, uint32_t dropped, double s){
+  printf("%-26s: p50=%u p90=%u p99=%u max=%u us  dropped=%u/%zu  %.1f submits/s\n", name,
+         pct_of(lat, 50), pct_of(lat, 90), pct_of(lat, 99), pct_of(lat, 100), dropped, lat.size(),
+         lat.size() / s);
+}
+
+// 写任务饱和：同一帧背靠背提交 o.shots 次（拷贝进环形区），两种实现各跑一轮
+static void run_submit(const Opt& o){
+  camera_fb_t* fb = esp_camera_fb_get();
+  if(!fb){ fprintf(stderr, "no frame\n"); return; }
+  std::vector<uint8_t> frame(fb->buf, fb->buf + fb->len);
+  esp_camera_fb_return(fb);
+  printf("\n== submit latency, %d back-to-back submits of %zu KB, timeout %u ms ==\n", o.shots,
+         frame.size() / 1024, ASYNC_SD_SUBMIT_TIMEOUT_MS);
+
+  legacy::mtx = xSemaphoreCreateMutex();
+  legacy::q = xQueueCreate(ASYNC_SD_QUEUE_LENGTH, sizeof(legacy::Job));
+  legacy::arena = (uint8_t*)malloc(ASYNC_SD_ARENA_SIZE);
+  legacy::running = true;
+  std::thread wr(legacy::writer);
+  std::vector<uint32_t> lat;
+  uint32_t dropped = 0;
+  char path[48];
+  int64_t t0 = esp_timer_get_time();
+  for(int i = 0; i < o.shots; i++){
+    snprintf(path, sizeof(path), "/sub_old_%05d.jpg", i);
+    int64_t s = esp_timer_get_time();
+    if(!legacy::submit(path, frame.data(), frame.size(), ASYNC_SD_SUBMIT_TIMEOUT_MS)) dropped++;
+    lat.push_back((uint32_t)(esp_timer_get_time() - s));
+  }
+  double secs = (esp_timer_get_time() - t0) / 1e6;
+  legacy::running = false;
+  wr.join();
+  print_submit("old: mutex arena + xQueue", lat, dropped, secs);
+  free(legacy::arena);
+
+  sd_async_flush();
+  lat.clear(); dropped = 0;
+  t0 = esp_timer_get_time();
+  for(int i = 0; i < o.shots; i++){
+    snprintf(path, sizeof(path), "/sub_new_%05d.jpg", i);
+    int64_t s = esp_timer_get_time();
+    if(!sd_async_submit(path, frame.data(), frame.size(), ASYNC_SD_SUBMIT_TIMEOUT_MS)) dropped++;
+    lat.push_back((uint32_t)(esp_timer_get_time() - s));
+  }
+  secs = (esp_timer_get_time() - t0) / 1e6;
+  sd_async_flush();
+  print_submit("new: SPSC ring", lat, dropped, secs);
+}
+
+int main(int argc, char** argv){
+  Opt o;
+  int c;
+  while((c = getopt(argc, argv, "n:i:f:p:m:o:j:h")) != -1){
+    switch(c){
+      case 'n': o.shots = atoi(optarg); break;
+      case 'i': o.interval_ms = atoi(optarg); break;
+      case 'f': o.frame_us = atoi(optarg); break;
+      case 'p': o.profile = optarg; break;
+      case 'm': o.mode = optarg; break;
+      case 'j': o.jpeg_dir = optarg; break;
+      case 'o': o.out = !strcmp(optarg, "ring") ? SD_OUT_RING : !strcmp(optarg, "segment") ? SD_OUT_SEGMENT : SD_OUT_FILES; break;
+      default: usage();
+    }
+  }
+  const Profile* prof = nullptr;
+  for(auto& p : PROFILES) if(!strcmp(p.name, o.profile)) prof = &p;
+  if(!prof || o.shots <= 0) usage();
+
+  if(o.jpeg_dir){
+    if(!sim_sensor_load_dir(o.jpeg_dir)){ fprintf(stderr, "no *.jpg in %s\n", o.jpeg_dir); return 1; }
+  }else make_frames();
+  sim_sensor_config({ o.frame_us, 0, 4000, 0, 0 });
+
+  char root[] = "/tmp/esp32cam_sd.XXXXXX";
+  if(!mkdtemp(root)){ perror("mkdtemp"); return 1; }
+  sim_sd_mount(root, prof->p);
+
+  sd_async_set_output_mode(o.out);
+  int64_t t_mount = esp_timer_get_time();
+  init_sd();
+  t_mount = esp_timer_get_time() - t_mount;
+  photo_index_restore();
+  flashInit(); flashOff();
+  camera_init_async();
+  if(!camera_init_wait(CAM_INIT_WAIT_MS) || !camera_ok){ fprintf(stderr, "camera init failed\n"); return 1; }
+  printf("profile=%s frame_us=%u interval_ms=%u out=%u sd=%s init_sd=%.1fms\n", prof->name, o.frame_us,
+         o.interval_ms, (unsigned)o.out, root, t_mount / 1e3);
+
+  if(!strcmp(o.mode, "submit")) run_submit(o);
+  else{
+    bool sync = strcmp(o.mode, "async"), async = strcmp(o.mode, "sync");
+    if(sync) run(false, o);
+    if(async) run(true, o);
+  }
+
+  SimSensorStats ss;
+  sim_sensor_get_stats(ss);
+  printf("\nsensor: grabs=%u timeouts=%u fb outstanding max=%u deinit_busy=%u bad_returns=%u\n",
+         ss.grabs, ss.timeouts, ss.outstanding_max, ss.deinit_busy, ss.bad_returns);
+  printf("\n");
+  perf_dump_text(Serial);   // 最后一轮的直方图 + 各模块登记的统计行
+  std::filesystem::remove_all(root);
+  return 0;
+}
\ No newline at end of file
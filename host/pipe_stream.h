@@ -0,0 +1,67 @@
+#pragma once
+// 主机测试用的双向字节流：接收方向为单生产者单消费者字节环（feed 写满即等，模拟串口持续到达），
+// 发送方向记录到内存，由测试取走解析；build_frame 按 proto.h 的帧格式组帧
+#include <Arduino.h>
+#include "proto.h"
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+class PipeStream : public Stream{
+public:
+  static const uint32_t N = 1 << 16;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* p, size_t n) override {
+    std::lock_guard<std::mutex> lk(tx_mtx);
+    tx.insert(tx.end(), p, p + n);
+    return n;
+  }
+  int available() override { return (int)(wr.load(std::memory_order_acquire) - rd.load(std::memory_order_relaxed)); }
+  int read() override {
+    uint32_t r = rd.load(std::memory_order_relaxed);
+    if(r == wr.load(std::memory_order_acquire)) return -1;
+    int c = buf[r & (N - 1)];
+    rd.store(r + 1, std::memory_order_release);
+    return c;
+  }
+  // 写满即等，模拟串口持续到达
+  void feed(const uint8_t* p, size_t n){
+    while(n){
+      uint32_t w = wr.load(std::memory_order_relaxed);
+      uint32_t space = N - (w - rd.load(std::memory_order_acquire));
+      if(!space){ usleep(100); continue; }
+      uint32_t k = std::min<uint32_t>(space, n);
+      for(uint32_t i = 0; i < k; i++) buf[(w + i) & (N - 1)] = p[i];
+      wr.store(w + k, std::memory_order_release);
+      p += k; n -= k;
+    }
+  }
+  std::vector<uint8_t> take_tx(){
+    std::lock_guard<std::mutex> lk(tx_mtx);
+    std::vector<uint8_t> v;
+    v.swap(tx);
+    return v;
+  }
+private:
+  uint8_t buf[N];
+  std::atomic<uint32_t> wr{ 0 }, rd{ 0 };
+  std::mutex tx_mtx;
+  std::vector<uint8_t> tx;
+};
+
+static inline void build_frame(std::vector<uint8_t>& out, uint16_t cmd, uint16_t seq, const uint8_t* p, uint16_t len){
+  ProtoHdr h;
+  h.sync[0] = 0x7E; h.sync[1] = 0x7E;
+  h.ver = PLATFORM_VER;
+  h.dmodel = PLATFORM_DMODEL;
+  h.slave_id = PLATFORM_SLAVE_ID;
+  h.cmd = cmd; h.seq = seq; h.len = len;
+  uint16_t crc = proto_crc16(0, (const uint8_t*)&h + 2, sizeof(h) - 2);
+  crc = proto_crc16(crc, p, len);
+  size_t o = out.size();
+  out.resize(o + sizeof(h) + len + 2);
+  memcpy(&out[o], &h, sizeof(h));
+  if(len) memcpy(&out[o + sizeof(h)], p, len);
+  memcpy(&out[o + sizeof(h) + len], &crc, 2);
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+// 主机仿真：Arduino-ESP32 核心的最小替身，只覆盖本仓库用到的接口
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+using std::min;
+using std::max;
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define F(s) (s)
+#define ESP_IDF_VERSION_MAJOR 4
+
+#define LOW          0
+#define HIGH         1
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+#define FALLING      0x02
+#define RISING       0x01
+
+typedef int esp_err_t;
+#define ESP_OK   0
+#define ESP_FAIL -1
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+static inline int digitalPinToInterrupt(int pin){ return pin; }
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+bool psramFound();
+uint32_t getCpuFrequencyMhz();
+uint32_t esp_get_free_heap_size();
+[[noreturn]] void esp_restart();
+
+class Print{
+public:
+  virtual ~Print(){}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n){ size_t w = 0; while(n--) w += write(*buf++); return w; }
+  size_t write(const char* s){ return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const char* s){ return write(s); }
+  size_t println(const char* s = ""){ return write(s) + write("\n"); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek(){ return -1; }
+  void setTimeout(unsigned long ms){ _timeout = ms; }
+  // 与 Arduino 一致：超时前读满 n 字节或数据耗尽
+  size_t readBytes(uint8_t* buf, size_t n);
+protected:
+  unsigned long _timeout = 1000;
+};
+
+// 主机上的 Serial：输出到 stdout，无输入
+class HardwareSerial : public Stream{
+public:
+  void begin(unsigned long){ }
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buf, size_t n) override { return fwrite(buf, 1, n, stdout); }
+  int available() override { return 0; }
+  int read() override { return -1; }
+};
+extern HardwareSerial Serial;
+
+class EspClass{
+public:
+  uint32_t getCycleCount();   // 按 240 MHz 折算的虚拟周期计数，与片上一样 32 位回绕
+};
+extern EspClass ESP;
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+// 主机仿真：SD 卡文件映射到主机目录（sim_sd_mount 指定），可注入延迟与错误，见 sim.h
+#include <Arduino.h>
+#include <memory>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs{
+
+struct FileImpl;
+
+class File : public Stream{
+public:
+  File(){ }
+  explicit File(std::shared_ptr<FileImpl> p) : _p(p){ }
+  explicit operator bool() const;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t n) override;
+  int available() override;
+  int read() override { uint8_t c; return read(&c, 1) == 1 ? c : -1; }
+  size_t read(uint8_t* buf, size_t n);
+  bool seek(uint32_t pos);
+  size_t position() const;
+  size_t size() const;
+  void flush();
+  void close();
+  const char* path() const;
+private:
+  std::shared_ptr<FileImpl> _p;
+};
+
+class FS{
+public:
+  File open(const char* path, const char* mode = FILE_READ, bool create = false);
+  bool exists(const char* path);
+  bool remove(const char* path);
+  bool mkdir(const char* path);
+  bool rmdir(const char* path);
+};
+
+}   // namespace fs
+
+using fs::File;
+using fs::FS;
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+// 主机仿真：NVS 命名空间放在进程内存里，仿真“重启”时保留
+#include <Arduino.h>
+class Preferences{
+public:
+  bool begin(const char* ns, bool read_only = false);
+  void end();
+  bool clear();
+  size_t putBytes(const char* key, const void* v, size_t n);
+  size_t getBytes(const char* key, void* buf, size_t n);
+  size_t putUInt(const char* key, uint32_t v){ return putBytes(key, &v, sizeof(v)); }
+  uint32_t getUInt(const char* key, uint32_t def = 0){ uint32_t v; return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : def; }
+  size_t putUChar(const char* key, uint8_t v){ return putBytes(key, &v, sizeof(v)); }
+  uint8_t getUChar(const char* key, uint8_t def = 0){ uint8_t v; return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : def; }
+  size_t putString(const char* key, const char* s){ return putBytes(key, s, strlen(s) + 1); }
+  size_t getString(const char* key, char* buf, size_t n){ size_t r = getBytes(key, buf, n); if(r && n) buf[min(r, n) - 1] = '\0'; return r; }
+private:
+  char _ns[16] = {0};
+  bool _ro = true;
+  bool _open = false;
+};
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+#include <FS.h>
+#include <SPI.h>
+
+typedef enum{ CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN } sdcard_type_t;
+
+class SDClass : public fs::FS{
+public:
+  bool begin(uint8_t ss, SPIClass& spi);
+  void end();
+  sdcard_type_t cardType();
+  uint64_t totalBytes();
+  uint64_t usedBytes();
+};
+extern SDClass SD;
\ No newline at end of file
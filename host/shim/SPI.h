@@ -0,0 +1,9 @@
+#pragma once
+#include <Arduino.h>
+#define VSPI 3
+#define HSPI 2
+class SPIClass{
+public:
+  explicit SPIClass(int){ }
+  void begin(int8_t, int8_t, int8_t, int8_t){ }
+};
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include "driver/rtc_io.h"
+// 字段顺序与 IDF 4.x 一致（指定初始化须按声明顺序）
+typedef enum{ LEDC_LOW_SPEED_MODE = 0 } ledc_mode_t;
+typedef enum{ LEDC_TIMER_0 = 0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3 } ledc_timer_t;
+typedef enum{ LEDC_CHANNEL_0 = 0, LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_3,
+              LEDC_CHANNEL_4, LEDC_CHANNEL_5, LEDC_CHANNEL_6, LEDC_CHANNEL_7 } ledc_channel_t;
+typedef enum{ LEDC_INTR_DISABLE = 0 } ledc_intr_type_t;
+typedef enum{ LEDC_AUTO_CLK = 0 } ledc_clk_cfg_t;
+typedef int ledc_timer_bit_t;
+typedef struct{
+  ledc_mode_t speed_mode;
+  ledc_timer_bit_t duty_resolution;
+  ledc_timer_t timer_num;
+  uint32_t freq_hz;
+  ledc_clk_cfg_t clk_cfg;
+} ledc_timer_config_t;
+typedef struct{
+  int gpio_num;
+  ledc_mode_t speed_mode;
+  ledc_channel_t channel;
+  ledc_intr_type_t intr_type;
+  ledc_timer_t timer_sel;
+  uint32_t duty;
+  int hpoint;
+} ledc_channel_config_t;
+static inline int ledc_timer_config(const ledc_timer_config_t*){ return 0; }
+static inline int ledc_channel_config(const ledc_channel_config_t*){ return 0; }
+int ledc_set_duty(ledc_mode_t, ledc_channel_t, uint32_t duty);   // 仿真记录闪光灯亮灭
+static inline int ledc_update_duty(ledc_mode_t, ledc_channel_t){ return 0; }
\ No newline at end of file
@@ -0,0 +1,6 @@
+#pragma once
+typedef int gpio_num_t;
+static inline int rtc_gpio_hold_en(gpio_num_t){ return 0; }
+static inline int rtc_gpio_hold_dis(gpio_num_t){ return 0; }
+static inline int rtc_gpio_pullup_en(gpio_num_t){ return 0; }
+static inline int rtc_gpio_pulldown_dis(gpio_num_t){ return 0; }
\ No newline at end of file
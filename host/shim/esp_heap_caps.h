@@ -0,0 +1,7 @@
+#pragma once
+#include <stdlib.h>
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+static inline void* heap_caps_malloc(size_t n, uint32_t){ return malloc(n); }
+static inline void  heap_caps_free(void* p){ free(p); }
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+// 主机仿真：与 esp32-camera 的 esp_jpg_decode 回调约定相同，内部用 libjpeg 缩放解码
+#include <Arduino.h>
+typedef enum{ JPG_SCALE_NONE, JPG_SCALE_2X, JPG_SCALE_4X, JPG_SCALE_8X, JPG_SCALE_MAX = JPG_SCALE_8X } jpg_scale_t;
+typedef size_t (*jpg_reader_cb)(void* arg, size_t index, uint8_t* buf, size_t len);
+// data 为空：x=y=0 时为开始（w/h 为输出尺寸），x=w,y=h 时为结束；否则为 RGB888 块
+// 与片上一致：开始回调的返回值被忽略，只有数据块回调返回 false 才中止解码
+typedef bool (*jpg_writer_cb)(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data);
+esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void* arg);
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+#include "driver/rtc_io.h"
+typedef enum{
+  ESP_SLEEP_WAKEUP_UNDEFINED = 0,
+  ESP_SLEEP_WAKEUP_EXT0 = 2,
+  ESP_SLEEP_WAKEUP_TIMER = 4,
+} esp_sleep_wakeup_cause_t;
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+static inline int esp_sleep_enable_timer_wakeup(uint64_t){ return 0; }
+static inline int esp_sleep_enable_ext0_wakeup(gpio_num_t, int){ return 0; }
+[[noreturn]] void esp_deep_sleep_start();
\ No newline at end of file
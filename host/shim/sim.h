@@ -0,0 +1,69 @@
+#pragma once
+// 主机仿真的控制接口：基准与测试程序用来配置假传感器、仿真 SD 卡与按键
+#include <Arduino.h>
+#include <vector>
+
+// ---- 仿真 SD 卡：文件落在主机目录 root 下 ----
+struct SimSdProfile{
+  uint32_t open_us;           // 每次打开
+  uint32_t close_us;          // 每次关闭（含刷新目录项）
+  uint32_t write_call_us;     // 每次 write() 固定开销
+  uint32_t write_us_per_kb;   // 按字节数计的写入耗时，决定吞吐
+  uint32_t flush_us;
+  uint32_t remove_us;
+  uint32_t stall_every_kb;    // 每写满这么多 KB 额外卡顿 stall_us（卡内擦除/垃圾回收），0=不注入
+  uint32_t stall_us;
+  uint32_t fail_every_n;      // 每第 n 次 write() 失败，0=不注入
+  uint64_t capacity_bytes;    // totalBytes()
+};
+void sim_sd_mount(const char* root, const SimSdProfile& p);
+void sim_sd_set_present(bool present);   // false：cardType() 返回 CARD_NONE，后续操作失败
+struct SimSdStats{
+  uint32_t opens;
+  uint32_t writes;
+  uint32_t write_fail;
+  uint64_t bytes;
+  uint32_t removes;
+  uint32_t open_files;        // 当前未关闭的句柄
+};
+void sim_sd_get_stats(SimSdStats& out);
+
+// ---- 假传感器：按帧周期出帧，画面按 scene_us 切换到下一张 JPEG ----
+struct SimSensorCfg{
+  uint32_t frame_us;          // 传感器帧周期（GRAB_LATEST：取帧至少等到下一帧完成）
+  uint32_t scene_us;          // 每张源图保持的时间，0=每帧换一张
+  uint32_t fb_timeout_ms;     // 缓冲都被占用时 fb_get 的超时（驱动默认 4000）
+  uint8_t  init_fail;         // 接下来这么多次 esp_camera_init 失败
+  uint32_t max_xclk_hz;       // 高于此 XCLK 的初始化失败，0=不限
+};
+void sim_sensor_config(const SimSensorCfg& c);
+void sim_sensor_clear();
+void sim_sensor_add_frame(const uint8_t* jpg, size_t len);
+size_t sim_sensor_load_dir(const char* dir);   // 按文件名顺序载入 *.jpg，返回张数
+struct SimSensorStats{
+  uint32_t inits;
+  uint32_t grabs;
+  uint32_t timeouts;
+  uint32_t outstanding;       // 当前未归还的 fb
+  uint32_t outstanding_max;
+  uint32_t deinit_busy;       // deinit 时仍有 fb 未归还（片上即释放后使用）
+  uint32_t bad_returns;       // 归还了不属于驱动或已归还的 fb
+  uint32_t flash_on;          // 闪光灯点亮次数
+};
+void sim_sensor_get_stats(SimSensorStats& out);
+
+// ---- 合成画面 ----
+// 灰度图编码成 JPEG（libjpeg）
+void sim_jpeg_encode_gray(const uint8_t* gray, int w, int h, int quality, std::vector<uint8_t>& out);
+// 静态场景 + 噪声 + 可选移动方块（obj_w=0 时无），seed 决定噪声
+void sim_scene_gray(std::vector<uint8_t>& out, int w, int h, uint32_t seed, int obj_x, int obj_y,
+                    int obj_w, int obj_h, int gain_pct);
+
+// NVS 写入次数（putBytes 等），用于检查无谓的闪存擦写
+uint32_t sim_nvs_writes();
+
+// 按键：直接调用 attachInterrupt 注册的处理函数（在调用者线程中，如同中断）
+void sim_button_press();
+
+// 深睡/重启在仿真中结束进程；测试可改为回调
+extern void (*sim_on_halt)(const char* why);
\ No newline at end of file
@@ -0,0 +1,156 @@
+// Arduino 核心、时钟、GPIO、NVS、CRC 与睡眠/重启的主机替身
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_rom_crc.h>
+#include <esp_sleep.h>
+#include "driver/ledc.h"
+#include "sim.h"
+#include <time.h>
+#include <thread>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static int64_t now_us(){
+  static const auto t0 = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int64_t esp_timer_get_time(){ return now_us(); }
+uint32_t millis(){ return (uint32_t)(now_us() / 1000); }
+uint32_t micros(){ return (uint32_t)now_us(); }
+void delay(uint32_t ms){ std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+uint32_t EspClass::getCycleCount(){ return (uint32_t)(now_us() * 240); }
+uint32_t getCpuFrequencyMhz(){ return 240; }
+bool psramFound(){ return true; }
+uint32_t esp_get_free_heap_size(){ return 200 * 1024; }
+
+size_t Print::printf(const char* fmt, ...){
+  char small[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(small, sizeof(small), fmt, ap);
+  va_end(ap);
+  if(n < 0) return 0;
+  if((size_t)n < sizeof(small)) return write((const uint8_t*)small, n);
+  std::vector<char> big(n + 1);
+  va_start(ap, fmt);
+  vsnprintf(big.data(), big.size(), fmt, ap);
+  va_end(ap);
+  return write((const uint8_t*)big.data(), n);
+}
+
+size_t Stream::readBytes(uint8_t* buf, size_t n){
+  size_t got = 0;
+  uint32_t t0 = millis();
+  while(got < n){
+    int c = read();
+    if(c >= 0){ buf[got++] = (uint8_t)c; continue; }
+    if(millis() - t0 >= _timeout) break;
+    std::this_thread::yield();
+  }
+  return got;
+}
+
+// ---- GPIO：只记录电平与中断处理函数 ----
+static uint8_t g_pin_level[64];
+static void (*g_isr[64])();
+
+void pinMode(uint8_t, uint8_t){ }
+void digitalWrite(uint8_t pin, uint8_t val){ if(pin < 64) g_pin_level[pin] = val; }
+int digitalRead(uint8_t pin){ return pin < 64 ? g_pin_level[pin] : LOW; }
+void attachInterrupt(uint8_t pin, void (*isr)(), int){ if(pin < 64) g_isr[pin] = isr; }
+
+void sim_button_press(){
+  for(auto f : g_isr) if(f){ f(); return; }
+}
+
+// ---- 闪光灯 PWM：占空比由 0 变非 0 记一次点亮 ----
+static uint32_t g_duty[8];
+extern void sim_sensor_note_flash();
+int ledc_set_duty(ledc_mode_t, ledc_channel_t ch, uint32_t duty){
+  if(ch < 8){
+    if(!g_duty[ch] && duty) sim_sensor_note_flash();
+    g_duty[ch] = duty;
+  }
+  return 0;
+}
+
+// ---- 睡眠/重启 ----
+static void halt_default(const char* why){
+  fflush(stdout);
+  fprintf(stderr, "sim: halt (%s)\n", why);
+  exit(0);
+}
+void (*sim_on_halt)(const char*) = halt_default;
+
+void esp_restart(){ sim_on_halt("restart"); exit(0); }
+void esp_deep_sleep_start(){ sim_on_halt("deep sleep"); exit(0); }
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(){ return ESP_SLEEP_WAKEUP_UNDEFINED; }
+
+// ---- CRC：与 ROM 实现的输入/输出取反约定一致 ----
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len){
+  crc = ~crc;
+  while(len--){
+    crc ^= *buf++;
+    for(int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t* buf, uint32_t len){
+  crc = ~crc;
+  while(len--){
+    crc ^= *buf++;
+    for(int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0x8408 & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+// ---- NVS：命名空间 -> 键 -> 字节 ----
+static std::mutex g_nvs_mu;
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> g_nvs;
+static uint32_t g_nvs_writes = 0;
+
+uint32_t sim_nvs_writes(){ std::lock_guard<std::mutex> lk(g_nvs_mu); return g_nvs_writes; }
+
+bool Preferences::begin(const char* ns, bool read_only){
+  snprintf(_ns, sizeof(_ns), "%s", ns);
+  _ro = read_only;
+  _open = true;
+  return true;
+}
+
+void Preferences::end(){ _open = false; }
+
+bool Preferences::clear(){
+  if(!_open || _ro) return false;
+  std::lock_guard<std::mutex> lk(g_nvs_mu);
+  g_nvs.erase(_ns);
+  return true;
+}
+
+size_t Preferences::putBytes(const char* key, const void* v, size_t n){
+  if(!_open || _ro) return 0;
+  std::lock_guard<std::mutex> lk(g_nvs_mu);
+  const uint8_t* p = (const uint8_t*)v;
+  g_nvs[_ns][key].assign(p, p + n);
+  g_nvs_writes++;
+  return n;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t n){
+  if(!_open) return 0;
+  std::lock_guard<std::mutex> lk(g_nvs_mu);
+  auto ns = g_nvs.find(_ns);
+  if(ns == g_nvs.end()) return 0;
+  auto it = ns->second.find(key);
+  if(it == ns->second.end() || it->second.size() > n) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
\ No newline at end of file
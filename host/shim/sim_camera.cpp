@@ -0,0 +1,242 @@
+// 假传感器与 JPEG 编解码：帧按固定周期在后台“完成”，取帧拿到最新一帧的拷贝；
+// 归还或 deinit 时缓冲被涂写，释放后仍被读取的帧在 SD 上会表现为损坏
+#include <esp_camera.h>
+#include <esp_jpg_decode.h>
+#include "sim.h"
+#include <jpeglib.h>
+#include <dirent.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <setjmp.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+const resolution_info_t resolution[] = {
+  {96, 96}, {160, 120}, {176, 144}, {240, 176}, {240, 240}, {320, 240}, {400, 296}, {480, 320},
+  {640, 480}, {800, 600}, {1024, 768}, {1280, 720}, {1280, 1024}, {1600, 1200}, {0, 0},
+};
+
+static const int MAX_FB = 4;
+static const uint8_t POISON = 0xA5;
+
+struct Slot{ camera_fb_t fb; std::vector<uint8_t> data; bool busy; };
+
+static std::mutex g_mu;
+static std::condition_variable g_cv;
+static SimSensorCfg g_cfg = { 80000, 0, 4000, 0, 0 };
+static std::vector<std::vector<uint8_t>> g_frames;
+static SimSensorStats g_st = {};
+static Slot g_slot[MAX_FB];
+static int g_fb_count = 0;
+static bool g_active = false;
+static framesize_t g_size = FRAMESIZE_SVGA;
+static int64_t g_t0 = 0;
+static int64_t g_last_k = -1;   // 上次交出的帧序号
+
+void sim_sensor_config(const SimSensorCfg& c){ std::lock_guard<std::mutex> lk(g_mu); g_cfg = c; }
+void sim_sensor_clear(){ std::lock_guard<std::mutex> lk(g_mu); g_frames.clear(); }
+void sim_sensor_add_frame(const uint8_t* jpg, size_t len){
+  std::lock_guard<std::mutex> lk(g_mu);
+  g_frames.emplace_back(jpg, jpg + len);
+}
+void sim_sensor_get_stats(SimSensorStats& out){ std::lock_guard<std::mutex> lk(g_mu); out = g_st; }
+void sim_sensor_note_flash(){ std::lock_guard<std::mutex> lk(g_mu); g_st.flash_on++; }
+
+size_t sim_sensor_load_dir(const char* dir){
+  DIR* d = opendir(dir);
+  if(!d) return 0;
+  std::vector<std::string> names;
+  while(dirent* e = readdir(d)){
+    std::string n = e->d_name;
+    if(n.size() > 4 && (n.compare(n.size() - 4, 4, ".jpg") == 0 || n.compare(n.size() - 4, 4, ".JPG") == 0)) names.push_back(n);
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  size_t added = 0;
+  for(auto& n : names){
+    FILE* fp = fopen((std::string(dir) + "/" + n).c_str(), "rb");
+    if(!fp) continue;
+    std::vector<uint8_t> b;
+    uint8_t tmp[8192];
+    size_t r;
+    while((r = fread(tmp, 1, sizeof(tmp), fp)) > 0) b.insert(b.end(), tmp, tmp + r);
+    fclose(fp);
+    if(b.size() > 4 && b[0] == 0xFF && b[1] == 0xD8){ sim_sensor_add_frame(b.data(), b.size()); added++; }
+  }
+  return added;
+}
+
+static int s_set_framesize(sensor_t*, framesize_t f){
+  if(f >= FRAMESIZE_INVALID) return -1;
+  std::lock_guard<std::mutex> lk(g_mu);
+  g_size = f;
+  return 0;
+}
+static int s_ok(sensor_t*, int){ return 0; }
+static sensor_t g_sensor = { s_set_framesize, s_ok, s_ok, s_ok, s_ok, s_ok };
+
+esp_err_t esp_camera_init(const camera_config_t* c){
+  std::lock_guard<std::mutex> lk(g_mu);
+  if(g_active) return ESP_FAIL;
+  if(g_cfg.init_fail){ g_cfg.init_fail--; return ESP_FAIL; }
+  if(g_cfg.max_xclk_hz && (uint32_t)c->xclk_freq_hz > g_cfg.max_xclk_hz) return ESP_FAIL;
+  if(c->fb_count < 1 || c->fb_count > MAX_FB || g_frames.empty()) return ESP_FAIL;
+  g_fb_count = c->fb_count;
+  g_size = c->frame_size;
+  g_t0 = esp_timer_get_time();
+  g_last_k = -1;
+  g_active = true;
+  g_st.inits++;
+  return ESP_OK;
+}
+
+static void poison(Slot& s){ std::fill(s.data.begin(), s.data.end(), POISON); }
+
+esp_err_t esp_camera_deinit(){
+  std::lock_guard<std::mutex> lk(g_mu);
+  if(!g_active) return ESP_FAIL;
+  if(g_st.outstanding) g_st.deinit_busy++;
+  for(auto& s : g_slot) if(s.busy){ poison(s); s.busy = false; }
+  g_st.outstanding = 0;
+  g_active = false;
+  g_cv.notify_all();
+  return ESP_OK;
+}
+
+camera_fb_t* esp_camera_fb_get(){
+  std::unique_lock<std::mutex> lk(g_mu);
+  if(!g_active) return nullptr;
+  auto free_slot = [&]{ for(int i = 0; i < g_fb_count; i++) if(!g_slot[i].busy) return i; return -1; };
+  if(!g_cv.wait_for(lk, std::chrono::milliseconds(g_cfg.fb_timeout_ms), [&]{ return !g_active || free_slot() >= 0; }) || !g_active){
+    g_st.timeouts++;
+    return nullptr;
+  }
+  // 帧 k 在 t0+(k+1)*frame_us 完成；已交出的最新帧不再重复交出
+  int64_t k = (esp_timer_get_time() - g_t0) / g_cfg.frame_us - 1;
+  if(k <= g_last_k){
+    k = g_last_k + 1;
+    int64_t due = g_t0 + (k + 1) * (int64_t)g_cfg.frame_us;
+    lk.unlock();
+    int64_t wait = due - esp_timer_get_time();
+    if(wait > 0) std::this_thread::sleep_for(std::chrono::microseconds(wait));
+    lk.lock();
+    if(!g_active) return nullptr;
+  }
+  int i = free_slot();
+  if(i < 0){ g_st.timeouts++; return nullptr; }
+  g_last_k = k;
+  int64_t t_frame = k * (int64_t)g_cfg.frame_us;
+  size_t n = g_cfg.scene_us ? (size_t)(t_frame / g_cfg.scene_us) : (size_t)k;
+  const std::vector<uint8_t>& src = g_frames[n % g_frames.size()];
+  Slot& s = g_slot[i];
+  s.data = src;
+  s.busy = true;
+  s.fb = { s.data.data(), s.data.size(), resolution[g_size].width, resolution[g_size].height, PIXFORMAT_JPEG };
+  g_st.grabs++;
+  g_st.outstanding++;
+  g_st.outstanding_max = std::max(g_st.outstanding_max, g_st.outstanding);
+  return &s.fb;
+}
+
+void esp_camera_fb_return(camera_fb_t* fb){
+  std::lock_guard<std::mutex> lk(g_mu);
+  for(auto& s : g_slot){
+    if(&s.fb != fb) continue;
+    if(!s.busy) break;
+    poison(s);
+    s.busy = false;
+    g_st.outstanding--;
+    g_cv.notify_all();
+    return;
+  }
+  g_st.bad_returns++;
+}
+
+sensor_t* esp_camera_sensor_get(){ return g_active ? &g_sensor : nullptr; }
+
+// ---- libjpeg 解码，回调约定同 esp32-camera ----
+struct JErr{ jpeg_error_mgr pub; jmp_buf jb; };
+static void j_error_exit(j_common_ptr c){ longjmp(((JErr*)c->err)->jb, 1); }
+
+esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void* arg){
+  std::vector<uint8_t> in(len);
+  if(reader(arg, 0, in.data(), len) != len) return ESP_FAIL;
+  jpeg_decompress_struct d;
+  JErr je;
+  d.err = jpeg_std_error(&je.pub);
+  je.pub.error_exit = j_error_exit;
+  std::vector<uint8_t> rows;
+  if(setjmp(je.jb)){ jpeg_destroy_decompress(&d); return ESP_FAIL; }
+  jpeg_create_decompress(&d);
+  jpeg_mem_src(&d, in.data(), len);
+  if(jpeg_read_header(&d, TRUE) != JPEG_HEADER_OK){ jpeg_destroy_decompress(&d); return ESP_FAIL; }
+  d.out_color_space = JCS_RGB;
+  d.scale_num = 1;
+  d.scale_denom = 1u << scale;
+  jpeg_start_decompress(&d);
+  uint16_t w = d.output_width, h = d.output_height;
+  writer(arg, 0, 0, w, h, nullptr);
+  bool ok = true;
+  const int BAND = 8;   // 按 MCU 行回调
+  rows.resize((size_t)w * 3 * BAND);
+  while(ok && d.output_scanline < h){
+    uint16_t y0 = d.output_scanline;
+    int got = 0;
+    while(got < BAND && d.output_scanline < h){
+      JSAMPROW r = rows.data() + (size_t)got * w * 3;
+      got += jpeg_read_scanlines(&d, &r, 1);
+    }
+    ok = writer(arg, 0, y0, w, got, rows.data());
+  }
+  if(ok){
+    jpeg_finish_decompress(&d);
+    ok = writer(arg, w, h, w, h, nullptr);
+  }else{
+    jpeg_abort_decompress(&d);
+  }
+  jpeg_destroy_decompress(&d);
+  return ok ? ESP_OK : ESP_FAIL;
+}
+
+void sim_jpeg_encode_gray(const uint8_t* gray, int w, int h, int quality, std::vector<uint8_t>& out){
+  jpeg_compress_struct c;
+  jpeg_error_mgr e;
+  c.err = jpeg_std_error(&e);
+  jpeg_create_compress(&c);
+  unsigned char* mem = nullptr;
+  unsigned long n = 0;
+  jpeg_mem_dest(&c, &mem, &n);
+  c.image_width = w;
+  c.image_height = h;
+  c.input_components = 1;
+  c.in_color_space = JCS_GRAYSCALE;
+  jpeg_set_defaults(&c);
+  jpeg_set_quality(&c, quality, TRUE);
+  jpeg_start_compress(&c, TRUE);
+  while(c.next_scanline < (unsigned)h){
+    JSAMPROW r = (JSAMPROW)(gray + (size_t)c.next_scanline * w);
+    jpeg_write_scanlines(&c, &r, 1);
+  }
+  jpeg_finish_compress(&c);
+  out.assign(mem, mem + n);
+  free(mem);
+  jpeg_destroy_compress(&c);
+}
+
+void sim_scene_gray(std::vector<uint8_t>& out, int w, int h, uint32_t seed, int ox, int oy, int ow, int oh, int gain_pct){
+  out.resize((size_t)w * h);
+  uint32_t r = seed * 2654435761u + 1;
+  for(int y = 0; y < h; y++){
+    for(int x = 0; x < w; x++){
+      // 固定纹理：渐变 + 棋盘格 + 条纹，噪声约 ±4
+      int v = 60 + (x * 80) / w + (y * 40) / h + (((x >> 5) ^ (y >> 5)) & 1) * 30 + ((x / 7 + y / 11) % 5) * 4;
+      if(ow && x >= ox && x < ox + ow && y >= oy && y < oy + oh) v = 220 - ((x - ox) / 6 % 2) * 40;
+      r = r * 1664525u + 1013904223u;
+      v = v * gain_pct / 100 + (int)((r >> 24) % 9) - 4;
+      out[(size_t)y * w + x] = (uint8_t)std::min(255, std::max(0, v));
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+// FreeRTOS 替身：一个全局锁 + 每个对象一个条件变量，够仿真用
+#include "freertos/FreeRTOS.h"
+#include <Arduino.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <vector>
+
+static std::mutex g_k;
+
+struct SimTask{
+  TaskFunction_t fn;
+  void* arg;
+  uint32_t stack;
+  uint32_t notify = 0;
+  bool pending = false;
+  std::condition_variable cv;
+};
+
+struct SimSem{
+  UBaseType_t count, max;
+  std::condition_variable cv;
+};
+
+struct SimQueue{
+  UBaseType_t len, item;
+  std::deque<std::vector<uint8_t>> q;
+  std::condition_variable cv;
+};
+
+struct SimEvt{
+  EventBits_t bits = 0;
+  std::condition_variable cv;
+};
+
+static thread_local SimTask* t_self = nullptr;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(){
+  if(!t_self) t_self = new SimTask{ nullptr, nullptr, 8192 };   // 主线程或外部线程
+  return t_self;
+}
+
+// 等到 ready() 或超时；持有 g_k
+template<typename F>
+static bool wait_for(std::unique_lock<std::mutex>& lk, std::condition_variable& cv, TickType_t ticks, F ready){
+  if(ticks == portMAX_DELAY){ cv.wait(lk, ready); return true; }
+  return cv.wait_for(lk, std::chrono::milliseconds((uint64_t)ticks * portTICK_PERIOD_MS), ready);
+}
+
+static void* task_entry(void* p){
+  SimTask* t = (SimTask*)p;
+  t_self = t;
+  t->fn(t->arg);
+  return nullptr;   // 任务函数返回在 FreeRTOS 中是错误，这里容忍
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t stack, void* arg,
+                                   UBaseType_t, TaskHandle_t* out, BaseType_t){
+  SimTask* t = new SimTask{ fn, arg, stack };
+  if(out) *out = t;   // 先给出句柄：任务一开始就可能被通知
+  pthread_t th;
+  pthread_attr_t a;
+  pthread_attr_init(&a);
+  pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+  int rc = pthread_create(&th, &a, task_entry, t);
+  pthread_attr_destroy(&a);
+  if(rc != 0){ if(out) *out = nullptr; delete t; return pdFAIL; }
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t t){
+  if(t && t != t_self){ fprintf(stderr, "sim: vTaskDelete(other) unsupported\n"); abort(); }
+  pthread_exit(nullptr);   // 句柄不释放：其他任务可能还持有
+}
+
+void vTaskDelay(TickType_t ticks){
+  if(ticks == 0){ sched_yield(); return; }
+  std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)ticks * portTICK_PERIOD_MS));
+}
+
+TickType_t xTaskGetTickCount(){ return millis() / portTICK_PERIOD_MS; }
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t t){
+  SimTask* s = t ? t : (SimTask*)xTaskGetCurrentTaskHandle();
+  return s->stack;   // 主机上无法测量，报告整栈
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait){
+  SimTask* t = (SimTask*)xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lk(g_k);
+  wait_for(lk, t->cv, wait, [&]{ return t->notify != 0; });
+  uint32_t v = t->notify;
+  if(v) t->notify = clear ? 0 : v - 1;
+  t->pending = false;
+  return v;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t t){
+  return xTaskNotify(t, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t t, BaseType_t* woken){
+  xTaskNotify(t, 0, eIncrement);
+  if(woken) *woken = pdFALSE;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t t, uint32_t value, eNotifyAction action){
+  if(!t){ fprintf(stderr, "sim: notify on null task\n"); abort(); }
+  std::lock_guard<std::mutex> lk(g_k);
+  switch(action){
+    case eSetBits: t->notify |= value; break;
+    case eIncrement: t->notify++; break;
+    case eSetValueWithOverwrite: t->notify = value; break;
+    case eSetValueWithoutOverwrite: if(t->pending) return pdFAIL; t->notify = value; break;
+    default: break;
+  }
+  t->pending = true;
+  t->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_entry, uint32_t clear_exit, uint32_t* value, TickType_t wait){
+  SimTask* t = (SimTask*)xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lk(g_k);
+  if(!t->pending) t->notify &= ~clear_entry;
+  bool got = wait_for(lk, t->cv, wait, [&]{ return t->pending; });
+  if(value) *value = t->notify;
+  if(!got) return pdFALSE;
+  t->notify &= ~clear_exit;
+  t->pending = false;
+  return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t init){
+  return new SimSem{ init, max };
+}
+SemaphoreHandle_t xSemaphoreCreateBinary(){ return xSemaphoreCreateCounting(1, 0); }
+SemaphoreHandle_t xSemaphoreCreateMutex(){ return xSemaphoreCreateCounting(1, 1); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait){
+  std::unique_lock<std::mutex> lk(g_k);
+  if(!wait_for(lk, s->cv, wait, [&]{ return s->count > 0; })) return pdFALSE;
+  s->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s){
+  std::lock_guard<std::mutex> lk(g_k);
+  if(s->count >= s->max) return pdFALSE;
+  s->count++;
+  s->cv.notify_one();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s){ delete s; }
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item){
+  return new SimQueue{ len, item };
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t wait){
+  std::unique_lock<std::mutex> lk(g_k);
+  if(!wait_for(lk, q->cv, wait, [&]{ return q->q.size() < q->len; })) return pdFALSE;
+  const uint8_t* p = (const uint8_t*)item;
+  q->q.emplace_back(p, p + q->item);
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* out, TickType_t wait){
+  std::unique_lock<std::mutex> lk(g_k);
+  if(!wait_for(lk, q->cv, wait, [&]{ return !q->q.empty(); })) return pdFALSE;
+  memcpy(out, q->q.front().data(), q->item);
+  q->q.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q){
+  std::lock_guard<std::mutex> lk(g_k);
+  return q->q.size();
+}
+
+EventGroupHandle_t xEventGroupCreate(){ return new SimEvt; }
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t e, EventBits_t bits){
+  std::lock_guard<std::mutex> lk(g_k);
+  e->bits |= bits;
+  e->cv.notify_all();
+  return e->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t e, EventBits_t bits){
+  std::lock_guard<std::mutex> lk(g_k);
+  EventBits_t old = e->bits;
+  e->bits &= ~bits;
+  return old;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t e, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t wait){
+  std::unique_lock<std::mutex> lk(g_k);
+  auto ok = [&]{ return all ? (e->bits & bits) == bits : (e->bits & bits) != 0; };
+  bool got = wait_for(lk, e->cv, wait, ok);
+  EventBits_t v = e->bits;
+  if(got && clear) e->bits &= ~bits;
+  return v;
+}
\ No newline at end of file
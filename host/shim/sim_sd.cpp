@@ -0,0 +1,155 @@
+// 仿真 SD 卡：文件映射到主机目录，按配置注入延迟与写错误
+#include <SD.h>
+#include "sim.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <atomic>
+#include <string>
+
+SDClass SD;
+
+static std::string g_root;
+static SimSdProfile g_prof;
+static std::atomic<bool> g_present{ true };
+static std::atomic<bool> g_mounted{ false };
+static std::atomic<uint32_t> g_opens{ 0 }, g_writes{ 0 }, g_write_fail{ 0 }, g_removes{ 0 }, g_open_files{ 0 };
+static std::atomic<uint64_t> g_bytes{ 0 };
+
+static void spend(uint32_t us){ if(us) usleep(us); }
+static bool ready(){ return g_mounted && g_present; }
+static std::string host_path(const char* p){ return g_root + (p[0] == '/' ? "" : "/") + p; }
+
+void sim_sd_mount(const char* root, const SimSdProfile& p){
+  g_root = root;
+  g_prof = p;
+  ::mkdir(root, 0755);
+}
+
+void sim_sd_set_present(bool present){ g_present = present; }
+
+void sim_sd_get_stats(SimSdStats& o){
+  o.opens = g_opens; o.writes = g_writes; o.write_fail = g_write_fail;
+  o.bytes = g_bytes; o.removes = g_removes; o.open_files = g_open_files;
+}
+
+namespace fs{
+
+struct FileImpl{
+  FILE* fp = nullptr;
+  std::string path;
+  ~FileImpl(){ if(fp){ fclose(fp); g_open_files--; } }
+};
+
+File::operator bool() const { return _p && _p->fp; }
+
+size_t File::write(const uint8_t* buf, size_t n){
+  if(!*this || !ready()) return 0;
+  uint32_t k = ++g_writes;
+  spend(g_prof.write_call_us + (uint32_t)(((uint64_t)n * g_prof.write_us_per_kb) >> 10));
+  if(g_prof.fail_every_n && k % g_prof.fail_every_n == 0){ g_write_fail++; return 0; }
+  size_t w = fwrite(buf, 1, n, _p->fp);
+  uint64_t b = g_bytes.fetch_add(w), blk = (uint64_t)g_prof.stall_every_kb << 10;
+  if(blk && b / blk != (b + w) / blk) spend(g_prof.stall_us);
+  return w;
+}
+
+int File::available(){
+  if(!*this) return 0;
+  long pos = ftell(_p->fp);
+  return pos < 0 ? 0 : (int)(size() - pos);
+}
+
+size_t File::read(uint8_t* buf, size_t n){
+  if(!*this || !ready()) return 0;
+  return fread(buf, 1, n, _p->fp);
+}
+
+bool File::seek(uint32_t pos){ return *this && fseek(_p->fp, pos, SEEK_SET) == 0; }
+size_t File::position() const { return *this ? ftell(_p->fp) : 0; }
+
+size_t File::size() const {
+  if(!*this) return 0;
+  fflush(_p->fp);
+  struct stat st;
+  return fstat(fileno(_p->fp), &st) == 0 ? st.st_size : 0;
+}
+
+void File::flush(){
+  if(!*this) return;
+  spend(g_prof.flush_us);
+  fflush(_p->fp);
+}
+
+void File::close(){
+  if(!_p) return;
+  if(_p->fp){
+    spend(g_prof.close_us);
+    fclose(_p->fp);
+    _p->fp = nullptr;
+    g_open_files--;
+  }
+  _p.reset();
+}
+
+const char* File::path() const { return _p ? _p->path.c_str() : ""; }
+
+File FS::open(const char* path, const char* mode, bool){
+  if(!ready()) return File();
+  spend(g_prof.open_us);
+  std::string hp = host_path(path);
+  struct stat st;
+  if(stat(hp.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) return File();
+  // "r+"：读写且不截断；Arduino 的 "w"/"a" 会创建文件
+  const char* m = !strcmp(mode, "r+") ? "r+b" : !strcmp(mode, "w") ? "wb" : !strcmp(mode, "a") ? "ab" : "rb";
+  FILE* fp = fopen(hp.c_str(), m);
+  if(!fp) return File();
+  g_opens++;
+  g_open_files++;
+  auto p = std::make_shared<FileImpl>();
+  p->fp = fp;
+  p->path = path;
+  return File(p);
+}
+
+bool FS::exists(const char* path){
+  if(!ready()) return false;
+  struct stat st;
+  return stat(host_path(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path){
+  if(!ready()) return false;
+  spend(g_prof.remove_us);
+  if(unlink(host_path(path).c_str()) != 0) return false;
+  g_removes++;
+  return true;
+}
+
+bool FS::mkdir(const char* path){ return ready() && ::mkdir(host_path(path).c_str(), 0755) == 0; }
+bool FS::rmdir(const char* path){ return ready() && ::rmdir(host_path(path).c_str()) == 0; }
+
+}   // namespace fs
+
+bool SDClass::begin(uint8_t, SPIClass&){
+  if(!g_present || g_root.empty()) return false;
+  g_mounted = true;
+  return true;
+}
+
+void SDClass::end(){ g_mounted = false; }
+sdcard_type_t SDClass::cardType(){ return ready() ? CARD_SDHC : CARD_NONE; }
+uint64_t SDClass::totalBytes(){ return ready() ? g_prof.capacity_bytes : 0; }
+
+static uint64_t g_walk;
+static int walk_cb(const char*, const struct stat* st, int type, struct FTW*){
+  if(type == FTW_F) g_walk += ((uint64_t)st->st_size + 32767) & ~(uint64_t)32767;   // 按 32 KB 簇计
+  return 0;
+}
+
+uint64_t SDClass::usedBytes(){
+  if(!ready()) return 0;
+  g_walk = 0;
+  nftw(g_root.c_str(), walk_cb, 16, FTW_PHYS);
+  return g_walk;
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+// 运动检测测试：合成序列逐帧标注（静止/运动/不计），报告每帧解码与 SAD 耗时、误触发率与漏检率。
+// -j 目录可换成录制的 JPEG 序列，文件名以 m 开头的帧视为运动，其余视为静止。
+// 末行 digest 为逐帧结果的摘要，SWAR 与逐像素两种构建须一致（make test 比对）
+#include "motion.h"
+#include "shim/sim.h"
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+static int g_fail = 0;
+#define CHECK(c) do{ if(!(c)){ printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); g_fail++; } }while(0)
+
+enum Label : uint8_t { STILL, MOVING, DONT_CARE };
+struct Frame{ std::vector<uint8_t> jpg; Label lab; };
+struct Seq{ std::string name; std::vector<Frame> frames; };
+
+struct Result{
+  uint32_t frames = 0, still = 0, moving = 0, false_hits = 0, misses = 0;
+  std::vector<uint32_t> decode_us, sad_us;
+};
+
+static uint32_t g_digest = 2166136261u;
+static void digest(uint32_t v){ for(int i = 0; i < 4; i++, v >>= 8) g_digest = (g_digest ^ (v & 0xFF)) * 16777619u; }
+
+static uint32_t pct_of(std::vector<uint32_t> v, int pct){
+  if(v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t i = (v.size() * pct + 99) / 100;
+  return v[i ? i - 1 : 0];
+}
+
+static void add_frame(Seq& s, int w, int h, uint32_t seed, int ox, int oy, int ow, int oh, int gain, Label lab){
+  std::vector<uint8_t> g;
+  Frame f;
+  sim_scene_gray(g, w, h, seed, ox, oy, ow, oh, gain);
+  sim_jpeg_encode_gray(g.data(), w, h, 80, f.jpg);
+  f.lab = lab;
+  s.frames.push_back(std::move(f));
+}
+
+// 方块横穿画面：完整进入画面前后不计
+static void add_walk(Seq& s, int w, int h, uint32_t& seed, int ow, int oh, int step){
+  for(int x = -ow; x < w; x += step){
+    bool inside = x >= 0 && x + ow <= w;
+    add_frame(s, w, h, seed++, x, h / 2 - oh / 2, ow, oh, 100, inside ? MOVING : DONT_CARE);
+  }
+}
+
+static std::vector<Seq> synth(){
+  std::vector<Seq> v;
+  const int W = 800, H = 600;
+  uint32_t seed = 1;
+  Seq s;
+  s = { "static" };
+  for(int i = 0; i < 60; i++) add_frame(s, W, H, seed++, 0, 0, 0, 0, 100, STILL);
+  v.push_back(s);
+  s = { "drift" };   // 曝光缓慢变化 +15%
+  for(int i = 0; i < 60; i++) add_frame(s, W, H, seed++, 0, 0, 0, 0, 100 + i / 4, STILL);
+  v.push_back(s);
+  s = { "lights" };  // 突然开灯：整体变化重学背景，不算运动
+  for(int i = 0; i < 60; i++) add_frame(s, W, H, seed++, 0, 0, 0, 0, i < 30 ? 100 : 150, STILL);
+  v.push_back(s);
+  s = { "walk" };
+  for(int i = 0; i < 10; i++) add_frame(s, W, H, seed++, 0, 0, 0, 0, 100, STILL);
+  add_walk(s, W, H, seed, 160, 200, 32);
+  for(int i = 0; i < 10; i++) add_frame(s, W, H, seed++, 0, 0, 0, 0, 100, STILL);
+  v.push_back(s);
+  s = { "stop" };    // 走进来停下：停住后 MOTION_ABSORB_POLLS 次内并入背景
+  for(int i = 0; i < 10; i++) add_frame(s, W, H, seed++, 0, 0, 0, 0, 100, STILL);
+  for(int x = -160; x <= 320; x += 32)
+    add_frame(s, W, H, seed++, x, 200, 160, 200, 100, x >= 0 ? MOVING : DONT_CARE);
+  for(int i = 0; i < 60; i++)
+    add_frame(s, W, H, seed++, 320, 200, 160, 200, 100, i <= MOTION_ABSORB_POLLS ? DONT_CARE : STILL);
+  v.push_back(s);
+  s = { "uxga" };    // 最大解码尺寸下的耗时
+  for(int i = 0; i < 10; i++) add_frame(s, 1600, 1200, seed++, 0, 0, 0, 0, 100, STILL);
+  add_walk(s, 1600, 1200, seed, 320, 400, 64);
+  v.push_back(s);
+  s = { "qxga" };    // OV3660 QXGA 按 1/8 解码为 256x192，超过 MOTION_MAX_W/H，须判为解码失败而不越界
+  for(int i = 0; i < 3; i++) add_frame(s, 2048, 1536, seed++, 0, 0, 0, 0, 100, DONT_CARE);
+  v.push_back(s);
+  return v;
+}
+
+static Seq load_dir(const char* dir){
+  Seq s = { dir };
+  std::vector<std::filesystem::path> files;
+  for(auto& e : std::filesystem::directory_iterator(dir)){
+    std::string ext = e.path().extension().string();
+    if(ext == ".jpg" || ext == ".jpeg" || ext == ".JPG") files.push_back(e.path());
+  }
+  std::sort(files.begin(), files.end());
+  for(auto& p : files){
+    Frame f;
+    FILE* fp = fopen(p.c_str(), "rb");
+    if(!fp) continue;
+    f.jpg.resize(std::filesystem::file_size(p));
+    f.jpg.resize(fread(f.jpg.data(), 1, f.jpg.size(), fp));
+    fclose(fp);
+    f.lab = p.filename().string()[0] == 'm' ? MOVING : STILL;
+    s.frames.push_back(std::move(f));
+  }
+  return s;
+}
+
+static Result run(const Seq& s){
+  Result r;
+  motion_reset();
+  MotionStats ms;
+  motion_get_stats(ms);
+  uint32_t fails = ms.decode_fail;
+  for(size_t i = 0; i < s.frames.size(); i++){
+    const Frame& f = s.frames[i];
+    camera_fb_t fb = {};
+    fb.buf = (uint8_t*)f.jpg.data();
+    fb.len = f.jpg.size();
+    fb.format = PIXFORMAT_JPEG;
+    bool hit = motion_feed(&fb);
+    motion_get_stats(ms);
+    r.frames++;
+    r.decode_us.push_back(ms.decode_us_last);
+    if(i && ms.decode_fail == fails) r.sad_us.push_back(ms.sad_us_last);   // 首帧只建背景，解码失败不比较
+    fails = ms.decode_fail;
+    digest(hit | ms.last_blocks << 1);
+    if(i == 0 || f.lab == DONT_CARE) continue;
+    if(f.lab == STILL){ r.still++; r.false_hits += hit; }
+    else{ r.moving++; r.misses += !hit; }
+  }
+  return r;
+}
+
+static void report(const char* name, const Result& r){
+  printf("%-8s %4u frames  decode p50/p95/max %5u/%5u/%5u us  sad p50/max %4u/%4u us  "
+         "false %u/%u (%.1f%%)  miss %u/%u (%.1f%%)\n",
+         name, r.frames, pct_of(r.decode_us, 50), pct_of(r.decode_us, 95), pct_of(r.decode_us, 100),
+         pct_of(r.sad_us, 50), pct_of(r.sad_us, 100),
+         r.false_hits, r.still, r.still ? 100.0 * r.false_hits / r.still : 0.0,
+         r.misses, r.moving, r.moving ? 100.0 * r.misses / r.moving : 0.0);
+}
+
+int main(int argc, char** argv){
+  const char* dir = nullptr;
+  for(int i = 1; i < argc; i++){
+    if(!strcmp(argv[i], "-j") && i + 1 < argc) dir = argv[++i];
+    else{ fprintf(stderr, "usage: test_motion [-j jpeg_dir]\n"); return 2; }
+  }
+  CHECK(motion_begin());
+  printf("motion: %s SAD, block %d, pix diff %d, min blocks %d\n",
+         MOTION_SWAR ? "SWAR" : "scalar", MOTION_BLOCK, MOTION_PIX_DIFF, MOTION_MIN_BLOCKS);
+  if(dir){
+    Seq s = load_dir(dir);
+    CHECK(!s.frames.empty());
+    report("recorded", run(s));
+  }else{
+    uint32_t oversize = 0;
+    for(const Seq& s : synth()){
+      if(s.name == "qxga") oversize = s.frames.size();
+      Result r = run(s);
+      report(s.name.c_str(), r);
+      CHECK(r.false_hits == 0);
+      CHECK(r.misses * 10 <= r.moving);   // 漏检不超过 10%
+    }
+    MotionStats ms;
+    motion_get_stats(ms);
+    CHECK(ms.decode_fail == oversize);
+  }
+  printf("digest: %08x\n", g_digest);
+  printf("%s\n", g_fail ? "test_motion: FAIL" : "test_motion: OK");
+  return g_fail ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+// 协议解帧测试：随机分块喂入合法帧、坏 CRC 帧、伪同步头与随机垃圾，
+// 核对每个合法帧按序只交付一次、payload 一致、统计计数；再测坏头长度卡住后的空闲重同步、
+// 吞吐（帧/s、字节/s）与 CMD_S_GET_STATS 回复
+#include "proto.h"
+#include "perf_stats.h"
+#include "shim/sim.h"
+#include "pipe_stream.h"
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+static int g_fail = 0;
+#define CHECK(c) do{ if(!(c)){ printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); g_fail++; } }while(0)
+
+static PipeStream g_pipe;
+
+// ---- 交付核对：处理函数在接收任务中运行 ----
+static const uint16_t CMD_A = 0x7001, CMD_B = 0x7002, CMD_UNREG = 0x7003, CMD_END = 0x7004;
+struct Expect{ uint16_t cmd, seq; std::vector<uint8_t> p; };
+static std::vector<Expect> g_expect;
+static size_t g_next = 0;
+static uint32_t g_bad = 0;
+static std::atomic<bool> g_end{ false };
+
+static void on_data(const ProtoFrame& f){
+  while(g_next < g_expect.size() && g_expect[g_next].cmd == CMD_UNREG) g_next++;
+  if(g_next >= g_expect.size()){ g_bad++; return; }
+  const Expect& e = g_expect[g_next++];
+  std::vector<uint8_t> got(f.len);
+  if(f.cmd != e.cmd || f.seq != e.seq || f.len != e.p.size() ||
+     f.n0 + f.n1 != f.len || proto_copy(f, 0, got.data(), f.len) != f.len || got != e.p)
+    g_bad++;
+}
+static void on_end(const ProtoFrame&){ g_end = true; }
+
+static bool wait_end(uint32_t ms){
+  for(uint32_t t = 0; t < ms && !g_end; t++) usleep(1000);
+  bool ok = g_end;
+  g_end = false;
+  return ok;
+}
+
+// 末尾补零：伪头声明的长度总能凑满，之后的结束帧不会被扣住
+static void push_end(std::vector<uint8_t>& s, uint16_t seq){
+  s.insert(s.end(), sizeof(ProtoHdr) + PROTO_MAX_PAYLOAD + 2, 0);
+  build_frame(s, CMD_END, seq, nullptr, 0);
+}
+
+static void test_crc(){
+  const uint8_t chk[] = "123456789";
+  CHECK(proto_crc16(0, chk, 9) == 0x906E);   // CRC-16/X-25 校验值
+  std::mt19937 rng(1);
+  std::vector<uint8_t> d(4096);
+  for(auto& b : d) b = rng();
+  uint16_t whole = proto_crc16(0, d.data(), d.size());
+  for(int k = 0; k < 100; k++){
+    size_t cut = rng() % d.size();
+    CHECK(proto_crc16(proto_crc16(0, d.data(), cut), d.data() + cut, d.size() - cut) == whole);
+  }
+  // 原始吞吐
+  const int rounds = 2000;
+  auto t0 = std::chrono::steady_clock::now();
+  uint16_t c = 0;
+  for(int i = 0; i < rounds; i++) c = proto_crc16(c, d.data(), d.size());
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  printf("crc16: %.1f MB/s (%04x)\n", rounds * d.size() / s / 1e6, c);
+}
+
+static void test_fuzz(uint32_t seed, int frames){
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> s, p;
+  uint32_t n_valid = 0, n_unreg = 0, n_corrupt = 0, n_fake = 0;
+  uint16_t seq = 0;
+  for(int i = 0; i < frames; i++){
+    uint32_t kind = rng() % 10;
+    uint16_t len = rng() % 4 ? rng() % 64 : rng() % (PROTO_MAX_PAYLOAD + 1);
+    p.resize(len);
+    for(auto& b : p) b = rng();
+    if(kind < 5){
+      uint16_t cmd = kind < 4 ? (rng() & 1 ? CMD_A : CMD_B) : CMD_UNREG;
+      build_frame(s, cmd, seq, p.data(), len);
+      g_expect.push_back({ cmd, seq, p });
+      seq++;
+      if(cmd == CMD_UNREG) n_unreg++; else n_valid++;
+    }else if(kind < 7){
+      // 坏帧：同步头之外翻转一位
+      size_t o = s.size();
+      build_frame(s, CMD_A, 0xFFFF, p.data(), len);
+      s[o + 2 + rng() % (s.size() - o - 2)] ^= 1 << (rng() % 8);
+      n_corrupt++;
+    }else if(kind < 9){
+      // 伪同步头 + 任意长度（含超长）
+      s.push_back(0x7E); s.push_back(0x7E);
+      uint16_t fl = rng() % (PROTO_MAX_PAYLOAD * 2);
+      for(int k = 0; k < 10; k++) s.push_back(k == 8 ? fl & 0xFF : k == 9 ? fl >> 8 : rng());
+      n_fake++;
+    }else{
+      for(uint32_t k = rng() % 200; k--; ) s.push_back(rng());
+    }
+  }
+  push_end(s, seq);
+
+  ProtoStats a, b;
+  proto_get_stats(a);
+  // 随机分块、随机停顿，帧头/CRC 落在读取边界与环回绕处
+  for(size_t o = 0; o < s.size(); ){
+    size_t k = std::min<size_t>(s.size() - o, 1 + rng() % 700);
+    g_pipe.feed(&s[o], k);
+    o += k;
+    if(rng() % 8 == 0) usleep(rng() % 2000);
+  }
+  CHECK(wait_end(10000));
+  proto_get_stats(b);
+  while(g_next < g_expect.size() && g_expect[g_next].cmd == CMD_UNREG) g_next++;
+  printf("fuzz seed=%u: %u valid, %u unhandled, %u corrupt, %u fake hdr, %zu bytes -> "
+         "rx %lu frames crc_err=%lu resync=%lu unh=%lu ovf=%lu bad=%u\n",
+         seed, n_valid, n_unreg, n_corrupt, n_fake, s.size(),
+         (unsigned long)(b.rx_frames - a.rx_frames), (unsigned long)(b.rx_crc_err - a.rx_crc_err),
+         (unsigned long)(b.rx_resync - a.rx_resync), (unsigned long)(b.rx_unhandled - a.rx_unhandled),
+         (unsigned long)(b.rx_overflow - a.rx_overflow), g_bad);
+  CHECK(g_bad == 0);
+  CHECK(g_next == g_expect.size());
+  CHECK(b.rx_frames - a.rx_frames == n_valid + n_unreg + 1);
+  CHECK(b.rx_unhandled - a.rx_unhandled == n_unreg);
+  CHECK(b.rx_bytes - a.rx_bytes == s.size());
+  CHECK(b.rx_overflow == a.rx_overflow);
+  CHECK(n_corrupt == 0 || b.rx_crc_err > a.rx_crc_err);
+  g_expect.clear(); g_next = 0; g_bad = 0;
+}
+
+// 空闲重同步：坏头声明的长度盖住其后的合法帧且链路随即空闲（不补零），
+// 须在 PROTO_RX_STALL_MS 后丢字节找回同步并交付这些帧
+static void test_stall(){
+  std::vector<uint8_t> s, p(8, 0xA5);
+  ProtoHdr h{};
+  h.sync[0] = 0x7E; h.sync[1] = 0x7E;
+  h.cmd = CMD_A; h.len = PROTO_MAX_PAYLOAD;
+  s.insert(s.end(), (const uint8_t*)&h, (const uint8_t*)&h + sizeof(h));
+  build_frame(s, CMD_A, 0x55, p.data(), p.size());
+  g_expect.push_back({ CMD_A, 0x55, p });
+  build_frame(s, CMD_END, 0x56, nullptr, 0);
+  ProtoStats a, b;
+  proto_get_stats(a);
+  auto t0 = std::chrono::steady_clock::now();
+  g_pipe.feed(s.data(), s.size());
+  CHECK(wait_end(PROTO_RX_STALL_MS * 4 + 1000));
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  proto_get_stats(b);
+  printf("stall: fake len=%u over %zu bytes -> delivered after %.0f ms, resync=%lu\n",
+         (unsigned)h.len, s.size(), ms, (unsigned long)(b.rx_resync - a.rx_resync));
+  CHECK(ms >= PROTO_RX_STALL_MS);
+  CHECK(b.rx_frames - a.rx_frames == 2);
+  CHECK(b.rx_resync > a.rx_resync);
+  CHECK(g_bad == 0 && g_next == g_expect.size());
+  g_expect.clear(); g_next = 0; g_bad = 0;
+}
+
+// 吞吐：连续合法帧。墙钟受 PROTO_RX_BUDGET/每 tick 限制，解析耗时取 rx_busy_us
+static void test_throughput(uint16_t len, int frames){
+  std::vector<uint8_t> s, p(len, 0x5A);
+  for(int i = 0; i < frames; i++){
+    build_frame(s, CMD_A, (uint16_t)i, p.data(), len);
+    g_expect.push_back({ CMD_A, (uint16_t)i, p });
+  }
+  push_end(s, 0);
+  ProtoStats a, b;
+  proto_get_stats(a);
+  auto t0 = std::chrono::steady_clock::now();
+  g_pipe.feed(s.data(), s.size());
+  CHECK(wait_end(30000));
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  proto_get_stats(b);
+  double busy = (b.rx_busy_us - a.rx_busy_us) / 1e6;
+  uint32_t nf = b.rx_frames - a.rx_frames;
+  printf("throughput payload=%u: %u frames in %.2fs -> %.0f frames/s %.0f KB/s; parse+dispatch %.3fs -> %.0f frames/s %.1f MB/s\n",
+         len, nf, wall, nf / wall, s.size() / wall / 1e3,
+         busy, busy > 0 ? nf / busy : 0.0, busy > 0 ? s.size() / busy / 1e6 : 0.0);
+  CHECK(g_bad == 0 && g_next == g_expect.size());
+  g_expect.clear(); g_next = 0; g_bad = 0;
+}
+
+// 从发送记录里解出 CMD_S_GET_STATS 回复，拼接 payload
+static bool stats_reply(uint16_t seq, std::string& body){
+  for(int t = 0; t < 2000; t++){
+    static std::vector<uint8_t> tx;
+    std::vector<uint8_t> more = g_pipe.take_tx();
+    tx.insert(tx.end(), more.begin(), more.end());
+    body.clear();
+    size_t o = 0;
+    while(o + sizeof(ProtoHdr) + 2 <= tx.size()){
+      ProtoHdr h;
+      memcpy(&h, &tx[o], sizeof(h));
+      if(h.sync[0] != 0x7E || h.sync[1] != 0x7E || o + sizeof(h) + h.len + 2 > tx.size()) break;
+      uint16_t crc, want = proto_crc16(0, &tx[o + 2], sizeof(h) - 2 + h.len);
+      memcpy(&crc, &tx[o + sizeof(h) + h.len], 2);
+      if(crc != want || h.cmd != CMD_S_GET_STATS || h.seq != seq || h.len > PROTO_STATS_CHUNK) return false;
+      if(!h.len){ tx.erase(tx.begin(), tx.begin() + o + sizeof(h) + 2); return true; }
+      body.append((const char*)&tx[o + sizeof(h)], h.len);
+      o += sizeof(h) + h.len + 2;
+    }
+    usleep(1000);
+  }
+  return false;
+}
+
+static void test_stats_cmd(){
+  std::vector<uint8_t> s;
+  std::string body;
+  uint8_t op = 's';
+  build_frame(s, CMD_S_GET_STATS, 0x1234, &op, 1);
+  g_pipe.feed(s.data(), s.size());
+  CHECK(stats_reply(0x1234, body));
+  CHECK(body.find("stage") == 0 && body.find("proto: rx") != std::string::npos);
+  printf("stats 's': %zu bytes in %zu frames\n", body.size(), (body.size() + PROTO_STATS_CHUNK - 1) / PROTO_STATS_CHUNK + 1);
+  s.clear(); op = 'b';
+  build_frame(s, CMD_S_GET_STATS, 0x1235, &op, 1);
+  g_pipe.feed(s.data(), s.size());
+  CHECK(stats_reply(0x1235, body));
+  CHECK(body.size() > 6 && body.compare(0, 4, "PSTA") == 0 && (uint8_t)body[5] == PS_COUNT);
+  s.clear(); op = 'r';
+  build_frame(s, CMD_S_GET_STATS, 0x1236, &op, 1);
+  g_pipe.feed(s.data(), s.size());
+  CHECK(stats_reply(0x1236, body) && body.empty());
+}
+
+int main(int argc, char** argv){
+  int frames = argc > 1 ? atoi(argv[1]) : 4000;
+  test_crc();
+  CHECK(proto_begin(&g_pipe));
+  CHECK(proto_on(CMD_A, on_data) && proto_on(CMD_B, on_data) && proto_on(CMD_END, on_end));
+  for(uint32_t seed = 1; seed <= 3; seed++) test_fuzz(seed, frames);
+  test_stall();
+  test_throughput(16, 10000);
+  test_throughput(1024, 500);
+  test_stats_cmd();
+  printf("%s\n", g_fail ? "test_proto: FAIL" : "test_proto: OK");
+  return g_fail ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+// 上传测试：平台端替身从发送记录里解出图片包，按概率丢掉各包的首次发送与首次确认（模拟有损链路），
+// 重组后与源帧比对；核对重传计数、帧缓冲全部归还，以及相邻两包的到达间隔不小于
+// PROTO_MIN_SEND_INTERVAL_MS（UPLINK_BURST=1 时逐包成立）。最后测链路不通时放弃并归还帧缓冲
+#include "uplink.h"
+#include "fb_ref.h"
+#include "proto.h"
+#include "shim/sim.h"
+#include "pipe_stream.h"
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+static int g_fail = 0;
+#define CHECK(c) do{ if(!(c)){ printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); g_fail++; } }while(0)
+
+// 发送时刻在写出帧头时记下，间隔不受平台端轮询抖动影响
+class TimedPipe : public PipeStream{
+public:
+  size_t write(const uint8_t* p, size_t n) override {
+    if(n == sizeof(ProtoHdr) && p[0] == 0x7E && p[1] == 0x7E){
+      std::lock_guard<std::mutex> lk(t_mtx);
+      t_frames.push_back(std::chrono::steady_clock::now());
+    }
+    return PipeStream::write(p, n);
+  }
+  std::chrono::steady_clock::time_point pop_time(){
+    std::lock_guard<std::mutex> lk(t_mtx);
+    auto t = t_frames.front();
+    t_frames.pop_front();
+    return t;
+  }
+private:
+  std::mutex t_mtx;
+  std::deque<std::chrono::steady_clock::time_point> t_frames;
+};
+static TimedPipe g_pipe;
+
+// ---- 平台端替身：在独立线程里轮询发送记录 ----
+struct Peer{
+  uint32_t drop_data_pct = 0;   // 各包首次发送的丢弃概率
+  uint32_t drop_ack_pct = 0;    // 各包首次确认的丢弃概率
+  bool     dead = false;        // 收包但从不确认
+  std::mt19937 rng{ 1 };
+  uint32_t image_id = 0;
+  std::vector<uint8_t> img;
+  std::vector<uint8_t> rx_tries, ack_tries, got;
+  uint32_t pkts = 0, dropped_data = 0, dropped_ack = 0, dup = 0;
+  double   min_gap_ms = 1e9;
+  std::chrono::steady_clock::time_point last;
+  bool     have_last = false;
+};
+static Peer g_peer;
+static std::mutex g_peer_mtx;
+static std::atomic<bool> g_stop{ false };
+
+static void on_pkt(Peer& p, const uint8_t* d, uint16_t len, std::chrono::steady_clock::time_point now){
+  if(len < sizeof(ImgPktMeta)) return;
+  ImgPktMeta m;
+  memcpy(&m, d, sizeof(m));
+  if(p.have_last) p.min_gap_ms = std::min(p.min_gap_ms, std::chrono::duration<double, std::milli>(now - p.last).count());
+  p.last = now; p.have_last = true;
+  p.pkts++;
+  if(m.image_id != p.image_id || p.img.size() != m.total_len){
+    p.image_id = m.image_id;
+    p.img.assign(m.total_len, 0);
+    p.rx_tries.assign(m.pkt_cnt, 0);
+    p.ack_tries.assign(m.pkt_cnt, 0);
+    p.got.assign(m.pkt_cnt, 0);
+  }
+  if(m.pkt_idx >= m.pkt_cnt || m.offset + (len - sizeof(m)) > m.total_len) return;
+  if(p.rx_tries[m.pkt_idx]++ == 0 && p.rng() % 100 < p.drop_data_pct){ p.dropped_data++; return; }
+  if(p.got[m.pkt_idx]) p.dup++;
+  p.got[m.pkt_idx] = 1;
+  memcpy(&p.img[m.offset], d + sizeof(m), len - sizeof(m));
+  if(p.dead) return;
+  if(p.ack_tries[m.pkt_idx]++ == 0 && p.rng() % 100 < p.drop_ack_pct){ p.dropped_ack++; return; }
+  ImgAck a{ m.image_id, m.pkt_idx, RESP_OK };
+  std::vector<uint8_t> s;
+  build_frame(s, CMD_S_IMAGE_ACK, 0, (const uint8_t*)&a, sizeof(a));
+  g_pipe.feed(s.data(), s.size());
+}
+
+static void peer_thread(){
+  std::vector<uint8_t> tx;
+  while(!g_stop){
+    std::vector<uint8_t> more = g_pipe.take_tx();
+    tx.insert(tx.end(), more.begin(), more.end());
+    size_t o = 0;
+    while(o + sizeof(ProtoHdr) + 2 <= tx.size()){
+      ProtoHdr h;
+      memcpy(&h, &tx[o], sizeof(h));
+      if(o + sizeof(h) + h.len + 2 > tx.size()) break;   // 半帧：等后续字节
+      auto sent = g_pipe.pop_time();
+      if(h.cmd == CMD_IMAGE_UPLOAD){
+        std::lock_guard<std::mutex> lk(g_peer_mtx);
+        on_pkt(g_peer, &tx[o + sizeof(h)], h.len, sent);
+      }
+      o += sizeof(h) + h.len + 2;
+    }
+    tx.erase(tx.begin(), tx.begin() + o);
+    usleep(1000);
+  }
+}
+
+// ---- 发送一帧并等结果 ----
+static std::vector<uint8_t> g_src;
+
+static bool upload(const char* name, uint32_t id, uint32_t drop_data, uint32_t drop_ack, bool dead){
+  {
+    std::lock_guard<std::mutex> lk(g_peer_mtx);
+    Peer& p = g_peer;
+    p.drop_data_pct = drop_data; p.drop_ack_pct = drop_ack; p.dead = dead;
+    p.rng.seed(id);
+    p.pkts = p.dropped_data = p.dropped_ack = p.dup = 0;
+    p.min_gap_ms = 1e9; p.have_last = false;
+  }
+  UplinkStats a, b;
+  uplink_get_stats(a);
+  camera_fb_t* fb = esp_camera_fb_get();
+  CHECK(fb && fb->len == g_src.size());
+  if(!fb) return false;
+  CHECK(fb_ref_begin(fb) && fb_ref_add(fb));
+  CHECK(uplink_submit_fb(fb, id));
+  fb_ref_release(fb);
+  auto t0 = std::chrono::steady_clock::now();
+  for(int t = 0; t < 30000; t++){
+    uplink_get_stats(b);
+    if(b.images_ok + b.images_fail != a.images_ok + a.images_fail) break;
+    usleep(1000);
+  }
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  usleep(20000);   // 确认在途时帧缓冲稍后才归还
+  SimSensorStats ss;
+  sim_sensor_get_stats(ss);
+  std::lock_guard<std::mutex> lk(g_peer_mtx);
+  const Peer& p = g_peer;
+  bool ok = b.images_ok > a.images_ok;
+  printf("%-6s drop data/ack %2u%%/%2u%%: %s in %.2fs, pkts=%u retx=%u dropped=%u/%u dup=%u min gap %.1f ms, fb outstanding=%u\n",
+         name, drop_data, drop_ack, ok ? "ok" : "fail", s, p.pkts, b.pkts_retx - a.pkts_retx,
+         p.dropped_data, p.dropped_ack, p.dup, p.min_gap_ms, ss.outstanding);
+  CHECK(b.images_ok + b.images_fail == a.images_ok + a.images_fail + 1);
+  CHECK(ss.outstanding == 0);
+  CHECK(p.pkts == b.pkts_sent - a.pkts_sent);
+#if UPLINK_BURST == 1
+  CHECK(p.min_gap_ms >= PROTO_MIN_SEND_INTERVAL_MS - 10);  // 令牌按整毫秒累计，取令牌到写出之间还有主机调度抖动
+#endif
+  if(ok) CHECK(p.img == g_src);
+  return ok;
+}
+
+int main(){
+  std::mt19937 rng(7);
+  g_src.resize(9 * UPLINK_PKT_PAYLOAD - 200);
+  for(auto& c : g_src) c = rng();
+  sim_sensor_add_frame(g_src.data(), g_src.size());
+  sim_sensor_config({ 10000, 0, 4000, 0, 0 });
+  camera_config_t cfg{};
+  cfg.xclk_freq_hz = 20000000;
+  cfg.frame_size = FRAMESIZE_QVGA;
+  cfg.fb_count = CAMERA_FB_COUNT;
+  CHECK(esp_camera_init(&cfg) == ESP_OK);
+  CHECK(proto_begin(&g_pipe));
+  CHECK(uplink_begin());
+  std::thread peer(peer_thread);
+
+  CHECK(upload("clean", 1, 0, 0, false));
+  UplinkStats st;
+  uplink_get_stats(st);
+  CHECK(st.pkts_retx == 0);
+  for(uint32_t id = 2; id <= 4; id++) CHECK(upload("lossy", id, 30, 30, false));
+  uplink_get_stats(st);
+  CHECK(st.pkts_retx > 0);
+  CHECK(!upload("dead", 5, 0, 0, true));
+
+  g_stop = true;
+  peer.join();
+  printf("%s\n", g_fail ? "test_uplink: FAIL" : "test_uplink: OK");
+  return g_fail ? 1 : 0;
+}
\ No newline at end of file
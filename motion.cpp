@@ -0,0 +1,180 @@
+#include "motion.h"
+#include "perf_stats.h"
+#include "esp_jpg_decode.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static_assert(MOTION_BLOCK % 4 == 0, "block width must be whole words");
+static_assert(MOTION_BLOCK * MOTION_BLOCK / 4 * 510 < 65536, "block too large for 16-bit SAD lanes");
+static_assert(MOTION_ABSORB_POLLS > 0 && MOTION_ABSORB_POLLS < 256, "absorb counter is 8-bit");
+
+static const uint32_t STRIDE = (MOTION_MAX_W + 3) & ~3u;   // 行按字对齐
+static const uint32_t MAX_BLOCKS = (MOTION_MAX_W / MOTION_BLOCK) * (MOTION_MAX_H / MOTION_BLOCK);
+
+static uint8_t*    g_cur = nullptr;
+static uint8_t*    g_bg = nullptr;
+static uint8_t     g_changed[(MAX_BLOCKS + 7) / 8];
+static uint8_t     g_stale[MAX_BLOCKS];      // 各块连续变化次数
+static uint16_t    g_w = 0, g_h = 0;         // 本帧缩小后的尺寸
+static uint16_t    g_bg_w = 0, g_bg_h = 0;
+static bool        g_relearn = true;
+static MotionStats g_ms = {};
+
+struct DecodeCtx{ const uint8_t* src; size_t len; bool ok; };
+
+static size_t jpg_read(void* arg, size_t index, uint8_t* buf, size_t len){
+  DecodeCtx* c = (DecodeCtx*)arg;
+  if(index >= c->len) return 0;
+  if(index + len > c->len) len = c->len - index;
+  if(buf) memcpy(buf, c->src + index, len);
+  return len;
+}
+
+// 解码器按 MCU 回调 RGB888，直接折成亮度 (r + 2g + b) / 4，不落整幅 RGB
+static bool gray_write(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data){
+  DecodeCtx* c = (DecodeCtx*)arg;
+  if(!data){
+    if(x == 0 && y == 0){
+      if(w > MOTION_MAX_W || h > MOTION_MAX_H){ c->ok = false; return false; }
+      g_w = w; g_h = h;
+    }
+    return true;
+  }
+  // 片上解码器忽略开始回调的返回值，尺寸超限时仍会送数据块，须在这里拦住
+  if(!c->ok || x + w > MOTION_MAX_W || y + h > MOTION_MAX_H){ c->ok = false; return false; }
+  for(uint16_t j = 0; j < h; j++){
+    const uint8_t* s = data + (size_t)j * w * 3;
+    uint8_t* d = g_cur + (size_t)(y + j) * STRIDE + x;
+    for(uint16_t i = 0; i < w; i++, s += 3) d[i] = (s[0] + 2 * s[1] + s[2]) >> 2;
+  }
+  return true;
+}
+
+#if MOTION_SWAR
+// 逐字节 |a-b|：带借位隔离的 4 路减法，a<b 的字节再取负
+static inline uint32_t absdiff4(uint32_t a, uint32_t b){
+  const uint32_t H = 0x80808080u;
+  uint32_t d  = ((a | H) - (b & ~H)) ^ ((a ^ ~b) & H);
+  uint32_t lt = (((~a & b) | (~(a ^ b) & d)) & H) >> 7;
+  return (d ^ (lt * 0xFF)) + lt;
+}
+#endif
+
+static uint32_t block_sad(const uint8_t* a, const uint8_t* b){
+#if MOTION_SWAR
+  uint32_t acc = 0;   // 两条 16 位累加通道
+  for(int r = 0; r < MOTION_BLOCK; r++){
+    const uint32_t* pa = (const uint32_t*)(a + r * STRIDE);
+    const uint32_t* pb = (const uint32_t*)(b + r * STRIDE);
+    for(int k = 0; k < MOTION_BLOCK / 4; k++){
+      uint32_t d = absdiff4(pa[k], pb[k]);
+      acc += (d & 0x00FF00FF) + ((d >> 8) & 0x00FF00FF);
+    }
+  }
+  return (acc & 0xFFFF) + (acc >> 16);
+#else
+  uint32_t sad = 0;
+  for(int r = 0; r < MOTION_BLOCK; r++){
+    const uint8_t* pa = a + r * STRIDE;
+    const uint8_t* pb = b + r * STRIDE;
+    for(int k = 0; k < MOTION_BLOCK; k++) sad += abs((int)pa[k] - (int)pb[k]);
+  }
+  return sad;
+#endif
+}
+
+static void block_follow(uint8_t* bg, const uint8_t* cur){
+  for(int r = 0; r < MOTION_BLOCK; r++){
+    uint8_t* pb = bg + r * STRIDE;
+    const uint8_t* pc = cur + r * STRIDE;
+    for(int k = 0; k < MOTION_BLOCK; k++) pb[k] += ((int)pc[k] - (int)pb[k]) / (1 << MOTION_BG_SHIFT);
+  }
+}
+
+static void block_copy(uint8_t* bg, const uint8_t* cur){
+  for(int r = 0; r < MOTION_BLOCK; r++) memcpy(bg + r * STRIDE, cur + r * STRIDE, MOTION_BLOCK);
+}
+
+static void relearn(){
+  memcpy(g_bg, g_cur, STRIDE * g_h);
+  g_bg_w = g_w;
+  g_bg_h = g_h;
+  g_relearn = false;
+  memset(g_stale, 0, sizeof(g_stale));
+  g_ms.relearns++;
+}
+
+static void dump_stats(Print& out){
+  if(!g_ms.polls) return;
+  out.printf("motion: polls=%lu hits=%lu relearn=%lu fail=%lu blocks=%lu/%lu decode=%lu/%luus sad=%lu/%luus\n",
+             (unsigned long)g_ms.polls, (unsigned long)g_ms.triggers, (unsigned long)g_ms.relearns,
+             (unsigned long)g_ms.decode_fail, (unsigned long)g_ms.last_blocks, (unsigned long)g_ms.blocks,
+             (unsigned long)g_ms.decode_us_last, (unsigned long)g_ms.decode_us_max,
+             (unsigned long)g_ms.sad_us_last, (unsigned long)g_ms.sad_us_max);
+}
+
+bool motion_begin(){
+  if(g_cur) return true;
+  perf_add_dump(dump_stats);
+  g_cur = (uint8_t*)heap_caps_malloc(STRIDE * MOTION_MAX_H, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  g_bg  = (uint8_t*)heap_caps_malloc(STRIDE * MOTION_MAX_H, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if(g_cur && g_bg) return true;
+  heap_caps_free(g_cur); heap_caps_free(g_bg);
+  g_cur = g_bg = nullptr;
+  return false;
+}
+
+void motion_reset(){
+  g_relearn = true;
+}
+
+bool motion_feed(const camera_fb_t* fb){
+  if(!g_cur || !fb || fb->format != PIXFORMAT_JPEG) return false;
+  g_ms.polls++;
+  int64_t t0 = esp_timer_get_time();
+  DecodeCtx c{ fb->buf, fb->len, true };
+  bool ok = esp_jpg_decode(fb->len, JPG_SCALE_8X, jpg_read, gray_write, &c) == ESP_OK && c.ok;
+  int64_t t1 = esp_timer_get_time();
+  g_ms.decode_us_last = (uint32_t)(t1 - t0);
+  if(g_ms.decode_us_last > g_ms.decode_us_max) g_ms.decode_us_max = g_ms.decode_us_last;
+  if(!ok){ g_ms.decode_fail++; return false; }
+  if(g_relearn || g_w != g_bg_w || g_h != g_bg_h){ relearn(); return false; }
+
+  const uint32_t thr = (uint32_t)MOTION_PIX_DIFF * MOTION_BLOCK * MOTION_BLOCK;
+  uint16_t bw = g_w / MOTION_BLOCK, bh = g_h / MOTION_BLOCK;
+  uint32_t blocks = (uint32_t)bw * bh, n = 0, i = 0;
+  memset(g_changed, 0, sizeof(g_changed));
+  for(uint16_t by = 0; by < bh; by++){
+    for(uint16_t bx = 0; bx < bw; bx++, i++){
+      uint32_t off = (uint32_t)by * MOTION_BLOCK * STRIDE + bx * MOTION_BLOCK;
+      if(block_sad(g_cur + off, g_bg + off) <= thr){ g_stale[i] = 0; continue; }
+      if(++g_stale[i] >= MOTION_ABSORB_POLLS){ g_stale[i] = 0; block_copy(g_bg + off, g_cur + off); continue; }
+      g_changed[i >> 3] |= 1 << (i & 7);
+      n++;
+    }
+  }
+  g_ms.blocks = blocks;
+  g_ms.last_blocks = n;
+  bool hit = false;
+  if(n * 100 > blocks * MOTION_MAX_BLOCKS_PCT){
+    relearn();   // 开关灯、云影等整体变化
+  }else{
+    i = 0;
+    for(uint16_t by = 0; by < bh; by++){
+      for(uint16_t bx = 0; bx < bw; bx++, i++){
+        if(g_changed[i >> 3] & (1 << (i & 7))) continue;
+        uint32_t off = (uint32_t)by * MOTION_BLOCK * STRIDE + bx * MOTION_BLOCK;
+        block_follow(g_bg + off, g_cur + off);
+      }
+    }
+    hit = n >= MOTION_MIN_BLOCKS;
+  }
+  g_ms.sad_us_last = (uint32_t)(esp_timer_get_time() - t1);
+  if(g_ms.sad_us_last > g_ms.sad_us_max) g_ms.sad_us_max = g_ms.sad_us_last;
+  if(hit) g_ms.triggers++;
+  return hit;
+}
+
+void motion_get_stats(MotionStats& out){
+  out = g_ms;
+}
\ No newline at end of file
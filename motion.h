@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "config.h"
+
+// 运动检测：JPEG 按 1/8 解码直接转灰度（不经 RGB565 整图），按 MOTION_BLOCK 分块，
+// 与背景求绝对差和（SWAR 一次 4 像素），变化块数在 [MOTION_MIN_BLOCKS, MOTION_MAX_BLOCKS_PCT] 内即判定为运动。
+// 变化块保持原背景，其余块按 1/2^MOTION_BG_SHIFT 跟随；尺寸变化或整体亮度突变时以当前帧重建背景。
+// 只由采集任务调用。
+
+struct MotionStats{
+  uint32_t polls;
+  uint32_t triggers;
+  uint32_t relearns;         // 重建背景次数（复位、尺寸变化、整体亮度突变）
+  uint32_t decode_fail;
+  uint32_t last_blocks;      // 最近一帧变化块数
+  uint32_t blocks;           // 每帧总块数
+  uint32_t decode_us_last;
+  uint32_t decode_us_max;
+  uint32_t sad_us_last;      // 分块 SAD + 背景更新
+  uint32_t sad_us_max;
+};
+
+bool motion_begin();
+// 送入一帧 JPEG；返回 true 表示检测到运动
+bool motion_feed(const camera_fb_t* fb);
+// 下一帧重建背景（拍照开闪光灯后、改参数后调用）
+void motion_reset();
+void motion_get_stats(MotionStats& out);
\ No newline at end of file
@@ -0,0 +1,395 @@
+#include "ota.h"
+#include "proto.h"
+#include "perf_stats.h"
+#include <Preferences.h>
+#include <MD5Builder.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#if UPGRADE_ENABLE
+
+static const uint32_t BLK = UPG_BLOCK_SIZE;
+static const uint32_t REG = OTA_BITMAP_BLOCK_SIZE;
+static const uint32_t MAX_REGIONS = (8UL * 1024UL * 1024UL) / OTA_BITMAP_BLOCK_SIZE;
+static_assert(OTA_BITMAP_BLOCK_SIZE % UPG_BLOCK_SIZE == 0 && OTA_BITMAP_BLOCK_SIZE / UPG_BLOCK_SIZE <= 8,
+              "bitmap block must hold 1..8 transfer blocks");
+static_assert(OTA_BITMAP_BLOCK_SIZE % 4096 == 0, "bitmap block must be erase-sector (4 KB) aligned");
+
+#define EVT_START   (1UL << 0)
+#define EVT_CANCEL  (1UL << 1)
+#define EVT_INFO    (1UL << 2)
+#define EVT_BLOCK   (1UL << 3)
+
+#pragma pack(push,1)
+struct BlockReq{ uint32_t offset; uint16_t len; };
+#pragma pack(pop)
+
+struct Stage{ int32_t region; uint8_t want, reqd, got; uint8_t* buf; };
+struct Inflight{ bool used; uint32_t off; uint16_t len; uint32_t sent_ms; uint8_t tries; uint8_t stage; uint8_t blk; };
+
+static TaskHandle_t      g_ota_task = nullptr;
+static SemaphoreHandle_t g_ota_mtx = nullptr;   // 保护 g_stage / g_inf / g_os.state（接收任务也会访问）
+static OtaStats          g_os = {};
+
+static const esp_partition_t* g_part = nullptr;
+static uint32_t g_total = 0;
+static uint8_t  g_md5[16];
+static uint8_t  g_info_resp = RESP_FAIL;
+static uint8_t  g_bmp[MAX_REGIONS / 8];
+static uint32_t g_regions = 0;
+static uint32_t g_scan = 0;          // 下一个待分配的位图块
+static uint32_t g_hash_pos = 0;      // 已累加进 MD5 的连续前缀（位图块数）
+static uint32_t g_unsaved = 0;
+static MD5Builder g_hash;
+
+static Stage    g_stage[OTA_STAGE_REGIONS];
+static Inflight g_inf[OTA_WINDOW];
+
+static inline bool bmp_get(uint32_t r){ return g_bmp[r >> 3] & (1 << (r & 7)); }
+static inline void bmp_set(uint32_t r){ g_bmp[r >> 3] |= 1 << (r & 7); }
+
+static void set_state(OtaState s){
+  xSemaphoreTake(g_ota_mtx, portMAX_DELAY);
+  g_os.state = s;
+  xSemaphoreGive(g_ota_mtx);
+}
+
+// ---- NVS：续传所需的文件信息与位图 ----
+static void md5_hex(const uint8_t* md5, char* out){
+  for(int i = 0; i < 16; i++) sprintf(out + i * 2, "%02x", md5[i]);
+}
+
+static void nvs_save(bool header){
+  Preferences p;
+  if(!p.begin(NVS_NS_UP, false)) return;
+  if(header){
+    char hex[33];
+    md5_hex(g_md5, hex);
+    p.putUChar(NVS_KEY_UP_STATE, OTA_DOWNLOAD);
+    p.putUInt(NVS_KEY_UP_TOTAL, g_total);
+    p.putString(NVS_KEY_UP_MD5HEX, hex);
+    p.putUInt(NVS_KEY_UP_BLKSZ, REG);
+  }
+  p.putUInt(NVS_KEY_UP_RECV, g_os.regions_done);
+  p.putBytes(NVS_KEY_UP_BITMAP, g_bmp, (g_regions + 7) / 8);
+  p.end();
+  g_unsaved = 0;
+}
+
+static void nvs_clear(){
+  Preferences p;
+  if(!p.begin(NVS_NS_UP, false)) return;
+  p.clear();
+  p.end();
+}
+
+static bool nvs_pending(){
+  Preferences p;
+  if(!p.begin(NVS_NS_UP, true)) return false;
+  bool r = p.getUChar(NVS_KEY_UP_STATE, OTA_IDLE) == OTA_DOWNLOAD;
+  p.end();
+  return r;
+}
+
+// 文件未变（大小、MD5、位图块大小一致）则载入位图，否则从头开始
+static void resume_or_reset(){
+  memset(g_bmp, 0, sizeof(g_bmp));
+  g_os.regions_done = 0;
+  Preferences p;
+  bool same = false;
+  if(p.begin(NVS_NS_UP, true)){
+    char hex[33], want[33];
+    md5_hex(g_md5, want);
+    same = p.getUChar(NVS_KEY_UP_STATE, OTA_IDLE) == OTA_DOWNLOAD &&
+           p.getUInt(NVS_KEY_UP_TOTAL, 0) == g_total &&
+           p.getUInt(NVS_KEY_UP_BLKSZ, 0) == REG &&
+           p.getString(NVS_KEY_UP_MD5HEX, hex, sizeof(hex)) && strcmp(hex, want) == 0 &&
+           p.getBytes(NVS_KEY_UP_BITMAP, g_bmp, (g_regions + 7) / 8) == (g_regions + 7) / 8;
+    p.end();
+  }
+  if(!same){
+    memset(g_bmp, 0, sizeof(g_bmp));
+    nvs_save(true);
+    return;
+  }
+  for(uint32_t r = 0; r < g_regions; r++) if(bmp_get(r)) g_os.regions_done++;
+  g_os.regions_resumed = g_os.regions_done;
+}
+
+// ---- 协议回调（接收任务） ----
+// 回调先于升级任务登记，任务未建好时不通知
+static void on_upgrade_cmd(const ProtoFrame& f){
+  uint8_t op = proto_u8(f, 0);
+  uint8_t resp = RESP_OK;
+  if(!g_ota_task){
+    resp = RESP_FAIL;
+  }else if(op == 1){
+    if(g_os.state == OTA_IDLE || g_os.state == OTA_FAILED) xTaskNotify(g_ota_task, EVT_START, eSetBits);
+    else resp = RESP_FAIL;
+  }else if(op == 0){
+    xTaskNotify(g_ota_task, EVT_CANCEL, eSetBits);
+  }else{
+    resp = RESP_UNSUPPORT;
+  }
+  ProtoIov iov = { &resp, 1 };
+  proto_reply_v(CMD_REMOTE_UPGRADE_CMD, f.seq, &iov, 1);
+}
+
+static void on_file_info(const ProtoFrame& f){
+  if(!g_ota_task || f.len < 21 || g_os.state != OTA_INFO) return;
+  g_info_resp = proto_u8(f, 0);
+  g_total = proto_u32(f, 1);
+  proto_copy(f, 5, g_md5, 16);
+  xTaskNotify(g_ota_task, EVT_INFO, eSetBits);
+}
+
+// 块数据从接收环直接拷进对应位图块的暂存区
+static void on_file_block(const ProtoFrame& f){
+  if(!g_ota_task || f.len < 7) return;
+  uint8_t  resp = proto_u8(f, 0);
+  uint32_t off = proto_u32(f, 1);
+  uint16_t len = proto_u16(f, 5);
+  bool hit = false;
+  xSemaphoreTake(g_ota_mtx, portMAX_DELAY);
+  if(g_os.state == OTA_DOWNLOAD){
+    for(auto& e : g_inf){
+      if(!e.used || e.off != off) continue;
+      if(resp != RESP_OK || len != e.len || f.len < 7 + len){
+        e.sent_ms = millis() - UPG_BLOCK_RESP_TIMEOUT;   // 下一轮立即重发
+        break;
+      }
+      Stage& s = g_stage[e.stage];
+      proto_copy(f, 7, s.buf + e.blk * BLK, len);
+      s.got |= 1 << e.blk;
+      e.used = false;
+      g_os.blocks_rx++;
+      hit = true;
+      break;
+    }
+  }
+  if(!hit) g_os.blocks_dup++;
+  xSemaphoreGive(g_ota_mtx);
+  if(hit) xTaskNotify(g_ota_task, EVT_BLOCK, eSetBits);
+}
+
+// ---- 下载 ----
+static bool send_block_req(Inflight& e){
+  BlockReq q{ e.off, e.len };
+  ProtoIov iov = { &q, sizeof(q) };
+  e.sent_ms = millis();
+  e.tries++;
+  return proto_send_v(CMD_FILE_BLOCK_REQ, &iov, 1);
+}
+
+// 取下一个要请求的块：先补已分配位图块中未请求的，再分配下一个缺失的位图块
+static bool next_block(uint8_t& si, uint8_t& blk){
+  for(si = 0; si < OTA_STAGE_REGIONS; si++){
+    Stage& s = g_stage[si];
+    uint8_t m = s.want & ~s.reqd;
+    if(s.region >= 0 && m){ blk = __builtin_ctz(m); return true; }
+  }
+  for(si = 0; si < OTA_STAGE_REGIONS; si++) if(g_stage[si].region < 0) break;
+  if(si >= OTA_STAGE_REGIONS) return false;
+  while(g_scan < g_regions && bmp_get(g_scan)) g_scan++;
+  if(g_scan >= g_regions) return false;
+  Stage& s = g_stage[si];
+  uint32_t n = min(REG, g_total - g_scan * REG);
+  s.region = g_scan++;
+  s.want = (uint8_t)((1u << ((n + BLK - 1) / BLK)) - 1);
+  s.reqd = 0;
+  s.got = 0;
+  blk = 0;
+  return true;
+}
+
+// 返回 false 表示某块重试用尽
+static bool pump_window(){
+  uint32_t now = millis();
+  bool ok = true;
+  xSemaphoreTake(g_ota_mtx, portMAX_DELAY);
+  for(auto& e : g_inf){
+    if(!e.used || now - e.sent_ms < UPG_BLOCK_RESP_TIMEOUT) continue;
+    if(e.tries > UPG_BLOCK_MAX_RETRY){ ok = false; break; }
+    send_block_req(e);
+    g_os.blocks_retx++;
+  }
+  for(auto& e : g_inf){
+    if(!ok || e.used) continue;
+    uint8_t si, blk;
+    if(!next_block(si, blk)) break;
+    Stage& s = g_stage[si];
+    s.reqd |= 1 << blk;
+    uint32_t off = s.region * REG + blk * BLK;
+    e.used = true;
+    e.off = off;
+    e.len = (uint16_t)min(BLK, g_total - off);
+    e.stage = si;
+    e.blk = blk;
+    e.tries = 0;
+    send_block_req(e);
+  }
+  xSemaphoreGive(g_ota_mtx);
+  return ok;
+}
+
+// 从 flash 回读连续前缀累加 MD5，顺带校验刚写入的内容
+static void hash_advance(uint8_t* tmp){
+  while(g_hash_pos < g_regions && bmp_get(g_hash_pos)){
+    uint32_t off = g_hash_pos * REG;
+    uint32_t n = min(REG, g_total - off);
+    if(esp_partition_read(g_part, off, tmp, n) != ESP_OK) return;
+    g_hash.add(tmp, n);
+    g_hash_pos++;
+  }
+}
+
+// 收齐的位图块整扇区擦写；收齐后不再有在途请求指向它，不需加锁
+static bool flush_stages(){
+  for(auto& s : g_stage){
+    if(s.region < 0 || s.got != s.want) continue;
+    uint32_t t0 = millis();
+    uint32_t off = s.region * REG;
+    uint32_t n = min(REG, g_total - off);
+    if(esp_partition_erase_range(g_part, off, REG) != ESP_OK) return false;
+    if(esp_partition_write(g_part, off, s.buf, n) != ESP_OK) return false;
+    bmp_set(s.region);
+    g_os.regions_done++;
+    hash_advance(s.buf);
+    g_os.flash_ms += millis() - t0;
+    xSemaphoreTake(g_ota_mtx, portMAX_DELAY);
+    s.region = -1;
+    xSemaphoreGive(g_ota_mtx);
+    if(++g_unsaved >= OTA_SAVE_EVERY) nvs_save(false);
+  }
+  return true;
+}
+
+static bool fetch_info(){
+  for(uint8_t t = 0; t < UPG_INFO_MAX_RETRY; t++){
+    g_info_resp = RESP_FAIL;
+    proto_send_v(CMD_FILE_INFO_REQ, nullptr, 0);
+    uint32_t ev = 0;
+    if(xTaskNotifyWait(0, EVT_INFO | EVT_CANCEL, &ev, pdMS_TO_TICKS(UPG_INFO_RESP_TIMEOUT)) != pdTRUE) continue;
+    if(ev & EVT_CANCEL) return false;
+    if(ev & EVT_INFO) return g_info_resp == RESP_OK;
+  }
+  return false;
+}
+
+// 返回前恢复 IDLE/FAILED；成功时切换启动分区并重启
+static bool run_upgrade(){
+  xSemaphoreTake(g_ota_mtx, portMAX_DELAY);
+  g_os = {};
+  g_os.state = OTA_INFO;
+  xSemaphoreGive(g_ota_mtx);
+  g_part = esp_ota_get_next_update_partition(nullptr);
+  if(!g_part || !fetch_info() || !g_total || g_total > g_part->size || g_total > MAX_REGIONS * REG){
+    set_state(OTA_FAILED);
+    return false;
+  }
+  g_regions = (g_total + REG - 1) / REG;
+  g_os.total = g_total;
+  g_os.regions = g_regions;
+  resume_or_reset();
+
+  bool ok = true;
+  for(auto& s : g_stage){
+    s.region = -1;
+    if(!s.buf) s.buf = (uint8_t*)heap_caps_malloc(REG, MALLOC_CAP_8BIT);
+    if(!s.buf) ok = false;
+  }
+  for(auto& e : g_inf) e.used = false;
+  g_scan = 0;
+  g_hash.begin();
+  g_hash_pos = 0;
+  if(ok) hash_advance(g_stage[0].buf);   // 续传：先补算已写部分
+
+  uint32_t t0 = millis();
+  if(ok) set_state(OTA_DOWNLOAD);
+  while(ok && g_os.regions_done < g_regions){
+    ok = pump_window() && flush_stages();
+    if(!ok || g_os.regions_done >= g_regions) break;
+    uint32_t ev = 0;
+    xTaskNotifyWait(0, EVT_BLOCK | EVT_CANCEL, &ev, pdMS_TO_TICKS(20));
+    if(ev & EVT_CANCEL){ nvs_clear(); ok = false; }
+    g_os.elapsed_ms = millis() - t0;
+    if(g_os.elapsed_ms) g_os.kBps = (uint32_t)((uint64_t)g_os.blocks_rx * BLK / g_os.elapsed_ms);
+  }
+  if(!ok) set_state(OTA_FAILED);   // 先停止接收块回复，再释放暂存区
+  for(auto& s : g_stage){ heap_caps_free(s.buf); s.buf = nullptr; }
+  if(!ok){
+    if(g_unsaved) nvs_save(false);   // 保留位图供续传
+    return false;
+  }
+
+  uint8_t got[16];
+  g_hash.calculate();
+  g_hash.getBytes(got);
+  if(g_hash_pos != g_regions || memcmp(got, g_md5, 16) != 0){
+    nvs_clear();   // 无法定位坏块，下次从头下载
+    set_state(OTA_FAILED);
+    return false;
+  }
+  if(esp_ota_set_boot_partition(g_part) != ESP_OK){
+    nvs_clear();
+    set_state(OTA_FAILED);
+    return false;
+  }
+  nvs_clear();
+  set_state(OTA_DONE);
+  delay(UPG_REBOOT_DELAY_MS);
+  esp_restart();
+  return true;
+}
+
+static void ota_task(void*){
+  bool resume = nvs_pending();   // 上次未完成：平台连上后直接续传
+  while(true){
+    uint32_t ev = 0;
+    if(!resume){
+      xTaskNotifyWait(0, UINT32_MAX, &ev, portMAX_DELAY);
+      if(!(ev & EVT_START)) continue;
+    }
+    resume = false;
+    run_upgrade();
+  }
+}
+
+static void dump_stats(Print& out){
+  OtaStats os;
+  ota_get_stats(os);
+  if(os.total)
+    out.printf("ota: state=%u %lu/%lu blocks (resumed %lu) rx=%lu retx=%lu dup=%lu flash=%lums %lums %lukB/s\n",
+               (unsigned)os.state, (unsigned long)os.regions_done, (unsigned long)os.regions,
+               (unsigned long)os.regions_resumed, (unsigned long)os.blocks_rx, (unsigned long)os.blocks_retx,
+               (unsigned long)os.blocks_dup, (unsigned long)os.flash_ms, (unsigned long)os.elapsed_ms,
+               (unsigned long)os.kBps);
+}
+
+bool ota_begin(){
+  if(g_ota_task) return true;
+  perf_add_dump(dump_stats);
+  g_ota_mtx = xSemaphoreCreateMutex();
+  if(!g_ota_mtx) return false;
+  // 先登记回调再建任务：任务启动即可能续传并发出 CMD_FILE_INFO_REQ，回复不能落到未登记的命令上
+  if(!proto_on(CMD_REMOTE_UPGRADE_CMD, on_upgrade_cmd) ||
+     !proto_on(CMD_FILE_INFO_REQ, on_file_info) ||
+     !proto_on(CMD_FILE_BLOCK_REQ, on_file_block)) return false;
+  return xTaskCreatePinnedToCore(ota_task, "ota", OTA_TASK_STACK, nullptr,
+                                 OTA_TASK_PRIO, &g_ota_task, OTA_TASK_CORE) == pdPASS;
+}
+
+void ota_get_stats(OtaStats& out){
+  out = g_os;
+}
+
+#else
+
+bool ota_begin(){ return false; }
+void ota_get_stats(OtaStats& out){ out = {}; }
+
+#endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 远程升级：平台下发 CMD_REMOTE_UPGRADE_CMD 后，设备先取文件信息，再保持 OTA_WINDOW 个
+// CMD_FILE_BLOCK_REQ 在途。收齐一个位图块（OTA_BITMAP_BLOCK_SIZE，等于擦除扇区）即整扇区擦写，
+// 位图定期存 NVS；重启后若文件大小与 MD5 未变，只补缺失的位图块。MD5 按连续前缀从 flash 回读累加。
+// 平台回复沿用请求的 cmd 与 seq。payload（小端）：
+//   CMD_REMOTE_UPGRADE_CMD  下行 {op u8: 1=开始 0=取消}        设备回 {resp u8}
+//   CMD_FILE_INFO_REQ       上行 {}                             平台回 {resp u8, total u32, md5[16]}
+//   CMD_FILE_BLOCK_REQ      上行 {offset u32, len u16}          平台回 {resp u8, offset u32, len u16, data}
+
+enum OtaState : uint8_t {
+  OTA_IDLE = 0,
+  OTA_INFO,          // 取文件信息
+  OTA_DOWNLOAD,
+  OTA_DONE,          // 已校验并切换启动分区，等待重启
+  OTA_FAILED
+};
+
+struct OtaStats{
+  uint8_t  state;
+  uint32_t total;
+  uint32_t regions;          // 位图块总数
+  uint32_t regions_done;
+  uint32_t regions_resumed;  // 本次启动前已完成的
+  uint32_t blocks_rx;
+  uint32_t blocks_retx;
+  uint32_t blocks_dup;       // 迟到或重复的回复
+  uint32_t flash_ms;         // 擦写 + 回读累加 MD5
+  uint32_t elapsed_ms;
+  uint32_t kBps;
+};
+
+// 须在 proto_begin() 之后调用；NVS 中有未完成的升级时自动续传
+bool ota_begin();
+void ota_get_stats(OtaStats& out);
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "perf_stats.h"
+#include <freertos/FreeRTOS.h>
+
+static PerfHist g_hist[PS_COUNT];
+static PerfDumpFn g_dump[PERF_DUMP_MAX];
+static uint8_t g_dump_n = 0;
+static portMUX_TYPE g_dump_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const STAGE_NAMES[PS_COUNT] = {
+  "flash_warm", "fb_get", "submit", "queue",
+  "sd_open", "sd_write", "sd_close", "frame_bytes",
+  "ret_delete", "flash_on", "settle_n"
+};
+
+uint32_t perf_cc_to_us(uint32_t cycles){
+  static uint32_t mhz = 0;
+  if(!mhz) mhz = getCpuFrequencyMhz();
+  return cycles / (mhz ? mhz : 240);
+}
+
+#if ENABLE_STATS_LOG
+void perf_record(PerfStage s, uint32_t v){
+  if(s >= PS_COUNT) return;
+  PerfHist& h = g_hist[s];
+  uint32_t i = v ? 31 - __builtin_clz(v) : 0;
+  if(i >= PERF_HIST_BUCKETS) i = PERF_HIST_BUCKETS - 1;
+  h.b[i]++;
+  h.count++;
+  if(v > h.max) h.max = v;
+  uint32_t lo = h.sum_lo + v;
+  if(lo < h.sum_lo) h.sum_hi++;
+  h.sum_lo = lo;
+}
+#endif
+
+uint32_t perf_percentile(const PerfHist& h, uint8_t pct){
+  if(!h.count) return 0;
+  uint32_t target = (uint32_t)(((uint64_t)h.count * pct + 99) / 100);
+  uint32_t acc = 0;
+  for(uint32_t i = 0; i < PERF_HIST_BUCKETS; i++){
+    acc += h.b[i];
+    if(acc >= target){
+      uint32_t upper = (i >= 31) ? 0xFFFFFFFFu : ((2u << i) - 1);
+      return upper < h.max ? upper : h.max;
+    }
+  }
+  return h.max;
+}
+
+void perf_get(PerfStage s, PerfHist& out){
+  if(s < PS_COUNT) out = g_hist[s];
+}
+
+void perf_reset(){
+  memset(g_hist, 0, sizeof(g_hist));
+}
+
+bool perf_add_dump(PerfDumpFn fn){
+  bool ok = true;
+  portENTER_CRITICAL(&g_dump_mux);
+  uint8_t i = 0;
+  while(i < g_dump_n && g_dump[i] != fn) i++;
+  if(i == g_dump_n){
+    if(g_dump_n < PERF_DUMP_MAX) g_dump[g_dump_n++] = fn;
+    else ok = false;
+  }
+  portEXIT_CRITICAL(&g_dump_mux);
+  return ok;
+}
+
+void perf_dump_text(Print& out){
+  out.println(F("stage        n       p50     p95     p99     max     avg"));
+  for(uint8_t s = 0; s < PS_COUNT; s++){
+    PerfHist h = g_hist[s];
+    uint64_t sum = ((uint64_t)h.sum_hi << 32) | h.sum_lo;
+    out.printf("%-11s %7lu %7lu %7lu %7lu %7lu %7lu\n", STAGE_NAMES[s],
+               (unsigned long)h.count,
+               (unsigned long)perf_percentile(h, 50),
+               (unsigned long)perf_percentile(h, 95),
+               (unsigned long)perf_percentile(h, 99),
+               (unsigned long)h.max,
+               (unsigned long)(h.count ? sum / h.count : 0));
+  }
+  for(uint8_t i = 0; i < g_dump_n; i++) g_dump[i](out);
+}
+
+void perf_dump_bin(Print& out){
+  static const uint8_t hdr[6] = { 'P', 'S', 'T', 'A', 1, PS_COUNT };
+  out.write(hdr, sizeof(hdr));
+  for(uint8_t s = 0; s < PS_COUNT; s++){
+    PerfHist h = g_hist[s];
+    out.write((const uint8_t*)&h, sizeof(h));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 热路径分段耗时统计：对数分桶直方图，记录一次只做一次 clz 和几次加法，可常开。
+// 每个分段只由一个任务写入（采集任务或写任务），因此无需加锁；导出时允许轻微撕裂。
+
+enum PerfStage : uint8_t {
+  PS_FLASH_WARM = 0,   // 开灯 -> 取到曝光收敛的帧
+  PS_FB_GET,           // esp_camera_fb_get()
+  PS_SUBMIT,           // 提交写任务（含等待空间）
+  PS_QUEUE,            // 作业在环中的驻留时间
+  PS_SD_OPEN,
+  PS_SD_WRITE,         // 每次 write() 调用
+  PS_SD_CLOSE,
+  PS_FRAME_SIZE,       // 帧字节数分布（单位：字节）
+  PS_RET_DELETE,       // 保留策略删除一个文件
+  PS_FLASH_ON,         // 每次拍照闪光灯点亮总时长（能耗）
+  PS_SETTLE_FRAMES,    // 收敛前取到的帧数（单位：帧）
+  PS_COUNT
+};
+
+#define PERF_HIST_BUCKETS 24   // 桶 i 覆盖 [2^i, 2^(i+1))；微秒时上限约 16s
+#define PERF_DUMP_MAX     12   // 可登记的模块统计行
+
+struct PerfHist {
+  uint32_t count;
+  uint32_t max;
+  uint32_t sum_lo;      // 累加和（64 位拆分，便于二进制导出）
+  uint32_t sum_hi;
+  uint32_t b[PERF_HIST_BUCKETS];
+};
+
+// 周期计数器计时（同一任务内的起止）；跨核的驻留时间改用 esp_timer
+static inline uint32_t perf_cc(){ return ESP.getCycleCount(); }
+uint32_t perf_cc_to_us(uint32_t cycles);
+
+#if ENABLE_STATS_LOG
+void perf_record(PerfStage s, uint32_t v);
+static inline void perf_record_cc(PerfStage s, uint32_t cc_start){
+  perf_record(s, perf_cc_to_us(perf_cc() - cc_start));
+}
+#else
+static inline void perf_record(PerfStage, uint32_t){}
+static inline void perf_record_cc(PerfStage, uint32_t){}
+#endif
+
+// 百分位（返回所在桶的上界，不超过 max）
+uint32_t perf_percentile(const PerfHist& h, uint8_t pct);
+void perf_get(PerfStage s, PerfHist& out);
+void perf_reset();
+
+// Serial 导出：文本一行一个分段；二进制为 "PSTA" + 版本 + 分段数 + PerfHist 数组
+void perf_dump_text(Print& out);
+// 各模块初始化时登记自己的统计行，perf_dump_text 在直方图之后按登记顺序输出；
+// 同一函数重复登记只保留一份，超过 PERF_DUMP_MAX 个返回 false
+typedef void (*PerfDumpFn)(Print& out);
+bool perf_add_dump(PerfDumpFn fn);
+void perf_dump_bin(Print& out);
\ No newline at end of file
@@ -1,32 +1,74 @@
 #include <Arduino.h>
 #include "config.h"
 #include "cam_sd.h"
+#include "perf_stats.h"
+#include "sd_retention.h"
+#include "proto.h"
+#include "uplink.h"
+#include "ota.h"
+#include <esp_sleep.h>
 
 void setup(){
+  // 深睡定时拍的定时唤醒：只走快速路径，不初始化串口/按键/写任务
+  if(timelapse_sleep_active()) timelapse_wake_cycle();
+  timelapse_sleep_stop();
+
   Serial.begin(SERIAL_BAUD);
+  // 摄像头初始化最慢，最先开始，与下面的等待和 SD 挂载重叠
+  camera_init_async();
   delay(200);
   wait_button_release_on_boot();
   pinMode(BUTTON_PIN, INPUT_PULLUP);
 
   init_sd();
-  camera_ok = init_camera_multi();
+  boot_mark(BOOT_SD);
+  photo_index_restore();
+  boot_mark(BOOT_INDEX);
   flashInit(); flashOff();
+  camera_init_wait(CAM_INIT_WAIT_MS);
 
-  if(camera_ok && DISCARD_FRAMES_ON_START>0){
-    discard_frames(DISCARD_FRAMES_ON_START);
-  }
+  SleepCycleStats sl;
+  if(timelapse_sleep_stats(sl) && sl.cycles)
+    Serial.printf("Sleep TL: cycles=%lu fail=%lu awake last=%lums max=%lums avg=%lums\n",
+                  (unsigned long)sl.cycles, (unsigned long)sl.fails, (unsigned long)sl.awake_ms_last,
+                  (unsigned long)sl.awake_ms_max, (unsigned long)sl.awake_ms_avg);
+  // 深睡定时拍在启动后台任务之前决定，入睡时没有任务还在用摄像头和 SD；
+  // 按键唤醒时留在正常模式，便于现场维护
+  if(SLEEP_TL_SEC_DEFAULT && esp_sleep_get_wakeup_cause()!=ESP_SLEEP_WAKEUP_EXT0)
+    timelapse_sleep_enter(SLEEP_TL_SEC_DEFAULT);
+
+  // 按键由中断触发，拍照在独立采集任务中完成
+  capture_task_start();
+  // 空间不足时后台删除最旧照片，而不是让保存失败
+  sd_retention_start();
+#if PROTO_LINK_ENABLE
+  // 上传/升级与日志共用串口，接收端按 7E 7E + CRC 重新同步，夹杂的文本日志会被丢弃
+  proto_begin(&Serial);
+#if UPLINK_ENABLE
+  uplink_begin();
+#endif
+#if OTA_ENABLE && UPGRADE_ENABLE
+  ota_begin();
+#endif
+#endif
+  boot_mark(BOOT_READY);
 
   Serial.printf("Boot: cam=%s, heap=%u\n", camera_ok?"OK":"FAIL", (unsigned)esp_get_free_heap_size());
+  boot_log(Serial);
 }
 
 void loop(){
-  static int lastBtn = HIGH;
-  int cur = digitalRead(BUTTON_PIN);
-  if(cur==LOW && lastBtn==HIGH){
-    capture_and_process(TRIGGER_BUTTON);
-  }
-  lastBtn = cur;
-
+  // SD 重挂退避留在 loop 任务，不阻塞采集
   periodic_sd_check();
-  delay(2);
+
+#if ENABLE_STATS_LOG && !PROTO_LINK_ENABLE
+  // 串口命令（协议链路启用时改用 CMD_S_GET_STATS）：s=文本统计，b=二进制统计，r=清零
+  if(Serial.available()){
+    int c = Serial.read();
+    if(c=='s') perf_dump_text(Serial);
+    else if(c=='b') perf_dump_bin(Serial);
+    else if(c=='r') perf_reset();
+  }
+#endif
+  delay(10);
 }
\ No newline at end of file
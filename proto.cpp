@@ -0,0 +1,319 @@
+#include "proto.h"
+#include "perf_stats.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+static_assert((PROTO_RX_RING & (PROTO_RX_RING - 1)) == 0, "rx ring must be a power of two");
+static_assert(PROTO_RX_RING >= 2 * (sizeof(ProtoHdr) + PROTO_MAX_PAYLOAD + 2), "rx ring too small");
+static const uint32_t RX_MASK = PROTO_RX_RING - 1;
+static const uint32_t HDR_LEN = sizeof(ProtoHdr);
+
+// 反射多项式 0x8408，逐字节查表
+static const uint16_t CRC16_TAB[256] = {
+  0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+  0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+  0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+  0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+  0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+  0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+  0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+  0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+  0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+  0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+  0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+  0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+  0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+  0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+  0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+  0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+  0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+  0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+  0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+  0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+  0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+  0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+  0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+  0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+  0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+  0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+  0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+  0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+  0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+  0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+  0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+  0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
+};
+
+uint16_t proto_crc16(uint16_t crc, const uint8_t* data, size_t len){
+  crc = ~crc;
+  while(len--) crc = (crc >> 8) ^ CRC16_TAB[(crc ^ *data++) & 0xFF];
+  return ~crc;
+}
+
+static Stream*           g_io = nullptr;
+static TaskHandle_t      g_rx_task = nullptr;
+static SemaphoreHandle_t g_tx_mtx = nullptr;
+static uint16_t          g_tx_seq = 0;
+static ProtoStats        g_ps = {};
+
+struct HandlerEnt{ uint16_t cmd; ProtoHandler h; };
+static HandlerEnt g_handlers[PROTO_MAX_HANDLERS];
+static uint8_t    g_handler_n = 0;
+static portMUX_TYPE g_handler_mux = portMUX_INITIALIZER_UNLOCKED;  // 注册可能发生在接收任务启动之后
+
+// ---- 接收环：只由接收任务读写，下标自由递增 ----
+static uint8_t  g_ring[PROTO_RX_RING];
+static uint32_t g_wr = 0;
+static uint32_t g_rd = 0;
+
+static inline uint8_t rb(uint32_t i){ return g_ring[i & RX_MASK]; }
+static inline uint16_t rb16(uint32_t i){ return rb(i) | (uint16_t)rb(i + 1) << 8; }
+
+static uint16_t crc_ring(uint16_t crc, uint32_t start, uint32_t n){
+  uint32_t s = start & RX_MASK;
+  uint32_t n0 = min(n, PROTO_RX_RING - s);
+  crc = proto_crc16(crc, g_ring + s, n0);
+  if(n > n0) crc = proto_crc16(crc, g_ring, n - n0);
+  return crc;
+}
+
+static uint32_t rx_fill(uint32_t budget){
+  int avail = g_io->available();
+  if(avail <= 0) return 0;
+  uint32_t want = min((uint32_t)avail, budget);
+  uint32_t space = PROTO_RX_RING - (g_wr - g_rd);
+  if(want > space){
+    // 解析器总会消费掉无效字节，环满只可能是上游失控；丢弃新数据
+    for(uint32_t i = space; i < want; i++) g_io->read();
+    g_ps.rx_overflow += want - space;
+    want = space;
+  }
+  uint32_t got = 0;
+  while(got < want){
+    uint32_t s = g_wr & RX_MASK;
+    uint32_t n = min(want - got, PROTO_RX_RING - s);
+    size_t r = g_io->readBytes(g_ring + s, n);
+    g_wr += r; got += r;
+    if(r < n) break;
+  }
+  g_ps.rx_bytes += got;
+  return got;
+}
+
+// 找下一帧；成功时 end 为该帧之后的读位置，处理完再推进 g_rd
+static bool rx_next(ProtoFrame& f, uint32_t& end){
+  while(g_wr - g_rd >= HDR_LEN + 2){
+    if(rb(g_rd) != 0x7E || rb(g_rd + 1) != 0x7E){ g_rd++; g_ps.rx_resync++; continue; }
+    uint16_t len = rb16(g_rd + 12);
+    if(len > PROTO_MAX_PAYLOAD){ g_rd++; g_ps.rx_resync++; continue; }
+    uint32_t need = HDR_LEN + len + 2;
+    if(g_wr - g_rd < need) return false;
+    if(crc_ring(0, g_rd + 2, HDR_LEN - 2 + len) != rb16(g_rd + HDR_LEN + len)){
+      g_rd++; g_ps.rx_crc_err++;
+      continue;
+    }
+    f.cmd = rb16(g_rd + 8);
+    f.seq = rb16(g_rd + 10);
+    f.len = len;
+    uint32_t s = (g_rd + HDR_LEN) & RX_MASK;
+    f.n0 = (uint16_t)min((uint32_t)len, PROTO_RX_RING - s);
+    f.p0 = g_ring + s;
+    f.n1 = len - f.n0;
+    f.p1 = g_ring;
+    end = g_rd + need;
+    return true;
+  }
+  return false;
+}
+
+static void dispatch(const ProtoFrame& f){
+  ProtoHandler h = nullptr;
+  portENTER_CRITICAL(&g_handler_mux);
+  for(uint8_t i = 0; i < g_handler_n; i++){
+    if(g_handlers[i].cmd == f.cmd){ h = g_handlers[i].h; break; }
+  }
+  portEXIT_CRITICAL(&g_handler_mux);
+  if(h) h(f);
+  else g_ps.rx_unhandled++;
+}
+
+static void proto_task(void*){
+  ProtoFrame f;
+  uint32_t end;
+  uint32_t last_rx = millis();
+  while(true){
+    uint32_t got = rx_fill(PROTO_RX_BUDGET);
+    bool stalled = false;
+    if(got) last_rx = millis();
+    else if(g_wr != g_rd && millis() - last_rx >= PROTO_RX_STALL_MS){
+      // 链路已空闲而环里仍有半帧：多半是坏头声明的长度偏大，丢一个字节重新找同步
+      g_rd++; g_ps.rx_resync++;
+      last_rx = millis();
+      stalled = true;
+    }
+    if(got || stalled){
+      int64_t t0 = esp_timer_get_time();
+      while(rx_next(f, end)){
+        dispatch(f);
+        g_rd = end;
+        g_ps.rx_frames++;
+      }
+      g_ps.rx_busy_us += (uint32_t)(esp_timer_get_time() - t0);
+    }
+    vTaskDelay(got ? 1 : pdMS_TO_TICKS(PROTO_RX_IDLE_MS));
+  }
+}
+
+uint8_t proto_u8(const ProtoFrame& f, uint16_t off){
+  if(off >= f.len) return 0;
+  return off < f.n0 ? f.p0[off] : f.p1[off - f.n0];
+}
+
+uint16_t proto_u16(const ProtoFrame& f, uint16_t off){
+  return proto_u8(f, off) | (uint16_t)proto_u8(f, off + 1) << 8;
+}
+
+uint32_t proto_u32(const ProtoFrame& f, uint16_t off){
+  return proto_u16(f, off) | (uint32_t)proto_u16(f, off + 2) << 16;
+}
+
+size_t proto_copy(const ProtoFrame& f, uint16_t off, void* dst, size_t n){
+  if(off >= f.len) return 0;
+  if(n > (size_t)(f.len - off)) n = f.len - off;
+  uint8_t* d = (uint8_t*)dst;
+  size_t done = 0;
+  if(off < f.n0){
+    size_t a = min(n, (size_t)(f.n0 - off));
+    memcpy(d, f.p0 + off, a);
+    done = a;
+    off = f.n0;
+  }
+  if(done < n) memcpy(d + done, f.p1 + (off - f.n0), n - done);
+  return n;
+}
+
+// ---- 发送 ----
+static bool send_frame(uint16_t cmd, uint16_t seq, const ProtoIov* iov, uint8_t n){
+  uint32_t len = 0;
+  for(uint8_t i = 0; i < n; i++) len += iov[i].n;
+  if(len > 0xFFFF) return false;
+
+  ProtoHdr h;
+  h.sync[0] = 0x7E; h.sync[1] = 0x7E;
+  h.ver = PLATFORM_VER;
+  h.dmodel = PLATFORM_DMODEL;
+  h.slave_id = PLATFORM_SLAVE_ID;
+  h.cmd = cmd;
+  h.seq = seq;
+  h.len = (uint16_t)len;
+  uint16_t crc = proto_crc16(0, (const uint8_t*)&h + 2, sizeof(h) - 2);
+  for(uint8_t i = 0; i < n; i++) crc = proto_crc16(crc, (const uint8_t*)iov[i].p, iov[i].n);
+
+  int64_t t0 = esp_timer_get_time();
+  size_t w = g_io->write((const uint8_t*)&h, sizeof(h));
+  for(uint8_t i = 0; i < n; i++) w += g_io->write((const uint8_t*)iov[i].p, iov[i].n);
+  w += g_io->write((const uint8_t*)&crc, sizeof(crc));
+  g_ps.tx_busy_us += (uint32_t)(esp_timer_get_time() - t0);
+  g_ps.tx_frames++;
+  g_ps.tx_bytes += w;
+  return w == sizeof(h) + len + sizeof(crc);
+}
+
+bool proto_send_v(uint16_t cmd, const ProtoIov* iov, uint8_t n){
+  if(!g_tx_mtx) return false;
+  xSemaphoreTake(g_tx_mtx, portMAX_DELAY);
+  bool ok = send_frame(cmd, g_tx_seq++, iov, n);
+  xSemaphoreGive(g_tx_mtx);
+  return ok;
+}
+
+bool proto_reply_v(uint16_t cmd, uint16_t seq, const ProtoIov* iov, uint8_t n){
+  if(!g_tx_mtx) return false;
+  xSemaphoreTake(g_tx_mtx, portMAX_DELAY);
+  bool ok = send_frame(cmd, seq, iov, n);
+  xSemaphoreGive(g_tx_mtx);
+  return ok;
+}
+
+bool proto_on(uint16_t cmd, ProtoHandler h){
+  bool ok = true;
+  portENTER_CRITICAL(&g_handler_mux);
+  uint8_t i = 0;
+  while(i < g_handler_n && g_handlers[i].cmd != cmd) i++;
+  if(i < g_handler_n) g_handlers[i].h = h;
+  else if(g_handler_n < PROTO_MAX_HANDLERS){
+    g_handlers[g_handler_n].cmd = cmd;
+    g_handlers[g_handler_n].h = h;
+    g_handler_n++;
+  }else ok = false;
+  portEXIT_CRITICAL(&g_handler_mux);
+  return ok;
+}
+
+static void dump_stats(Print& out){
+  ProtoStats ps = g_ps;
+  out.printf("proto: rx %lu frames %luB crc=%lu resync=%lu ovf=%lu unh=%lu busy=%lums, tx %lu frames %luB busy=%lums\n",
+             (unsigned long)ps.rx_frames, (unsigned long)ps.rx_bytes, (unsigned long)ps.rx_crc_err,
+             (unsigned long)ps.rx_resync, (unsigned long)ps.rx_overflow, (unsigned long)ps.rx_unhandled,
+             (unsigned long)(ps.rx_busy_us / 1000), (unsigned long)ps.tx_frames, (unsigned long)ps.tx_bytes,
+             (unsigned long)(ps.tx_busy_us / 1000));
+}
+
+#if ENABLE_STATS_LOG
+// 统计输出按 PROTO_STATS_CHUNK 切成多帧回复，沿用请求 seq，最后补一个空帧
+class StatsOut : public Print{
+public:
+  explicit StatsOut(uint16_t seq) : _seq(seq) {}
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* p, size_t n) override {
+    for(size_t i = 0; i < n; ){
+      size_t k = min(n - i, sizeof(_buf) - _n);
+      memcpy(_buf + _n, p + i, k);
+      _n += k; i += k;
+      if(_n == sizeof(_buf)) send();
+    }
+    return n;
+  }
+  void send(){
+    ProtoIov iov = { _buf, _n };
+    proto_reply_v(CMD_S_GET_STATS, _seq, &iov, _n ? 1 : 0);
+    _n = 0;
+  }
+  void finish(){ if(_n) send(); send(); }
+private:
+  uint16_t _seq;
+  uint16_t _n = 0;
+  uint8_t  _buf[PROTO_STATS_CHUNK];
+};
+
+// 协议链路占用串口时 loop 不再读串口命令，统计改由平台下发；发送在接收任务中阻塞，仅供调试
+static void on_get_stats(const ProtoFrame& f){
+  StatsOut out(f.seq);
+  uint8_t op = f.len ? proto_u8(f, 0) : 's';
+  if(op == 's') perf_dump_text(out);
+  else if(op == 'b') perf_dump_bin(out);
+  else if(op == 'r') perf_reset();
+  out.finish();
+}
+#endif
+
+bool proto_begin(Stream* io){
+  if(g_rx_task) return true;
+  if(!io) return false;
+  perf_add_dump(dump_stats);
+#if ENABLE_STATS_LOG
+  proto_on(CMD_S_GET_STATS, on_get_stats);
+#endif
+  g_io = io;
+  g_io->setTimeout(0);
+  g_tx_mtx = xSemaphoreCreateMutex();
+  if(!g_tx_mtx) return false;
+  return xTaskCreatePinnedToCore(proto_task, "prx", PROTO_TASK_STACK, nullptr,
+                                 PROTO_TASK_PRIO, &g_rx_task, PROTO_TASK_CORE) == pdPASS;
+}
+
+void proto_get_stats(ProtoStats& out){
+  out = g_ps;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 平台协议帧编解码。帧格式（小端）：
+//   7E 7E | ver | dmodel | slave_id(4) | cmd(2) | seq(2) | len(2) | payload(len) | crc16(2)
+//   crc16 覆盖 ver 起至 payload 末尾，算法与 esp_rom_crc16_le 相同（CRC-16/X-25，查表实现）
+// 接收：串口/TCP 字节进环形缓冲，原地找帧、校验，payload 以环内两段视图交给处理函数，不拷贝。
+// 发送：头、各段 payload、CRC 依次写出（分散写），图片数据直接从帧缓冲发送。
+// 接收与分发在独立任务中进行，每轮最多读 PROTO_RX_BUDGET 字节后让出，不挤占采集任务。
+// 半帧停留超过 PROTO_RX_STALL_MS 无新字节时丢一个字节重新找同步，坏头的长度不会卡住后续帧。
+
+#pragma pack(push,1)
+struct ProtoHdr{
+  uint8_t  sync[2];
+  uint8_t  ver;
+  uint8_t  dmodel;
+  uint32_t slave_id;
+  uint16_t cmd;
+  uint16_t seq;
+  uint16_t len;
+};
+#pragma pack(pop)
+
+// 收到的一帧：payload 位于接收环内，可能回绕成两段；只在处理函数内有效
+struct ProtoFrame{
+  uint16_t cmd;
+  uint16_t seq;
+  uint16_t len;
+  const uint8_t* p0; uint16_t n0;
+  const uint8_t* p1; uint16_t n1;
+};
+uint8_t  proto_u8(const ProtoFrame& f, uint16_t off);
+uint16_t proto_u16(const ProtoFrame& f, uint16_t off);
+uint32_t proto_u32(const ProtoFrame& f, uint16_t off);
+size_t   proto_copy(const ProtoFrame& f, uint16_t off, void* dst, size_t n);
+
+struct ProtoIov{ const void* p; uint16_t n; };
+
+struct ProtoStats{
+  uint32_t rx_frames;
+  uint32_t rx_bytes;
+  uint32_t rx_crc_err;
+  uint32_t rx_resync;      // 找同步头时丢弃的字节
+  uint32_t rx_overflow;    // 环满时丢弃的字节
+  uint32_t rx_unhandled;
+  uint32_t rx_busy_us;     // 解析 + 分发耗时
+  uint32_t tx_frames;
+  uint32_t tx_bytes;
+  uint32_t tx_busy_us;     // 含串口阻塞时间
+};
+
+typedef void (*ProtoHandler)(const ProtoFrame& f);
+
+bool proto_begin(Stream* io);
+bool proto_on(uint16_t cmd, ProtoHandler h);   // 处理函数在接收任务中运行，须尽快返回；可随时注册
+// 发送一帧；seq 自增。可多任务调用（内部加锁）
+bool proto_send_v(uint16_t cmd, const ProtoIov* iov, uint8_t n);
+// 回复：沿用请求的 seq
+bool proto_reply_v(uint16_t cmd, uint16_t seq, const ProtoIov* iov, uint8_t n);
+void proto_get_stats(ProtoStats& out);
+
+// CRC 可分段累加：crc = proto_crc16(crc, ...)，初值 0
+uint16_t proto_crc16(uint16_t crc, const uint8_t* data, size_t len);
\ No newline at end of file
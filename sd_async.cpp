@@ -1,151 +1,493 @@
 #include "sd_async.h"
+#include "sd_index.h"
+#include "sd_segment.h"
+#include "sd_ring.h"
+#include "perf_stats.h"
+#include "fb_ref.h"
+#include "frame_hdr.h"
 #include "config.h"
 #include <SD.h>
 #include <FS.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <freertos/event_groups.h>
 #include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <atomic>
+
+// 剩余空间缓存（KB）：挂载时统计一次，之后按写入/删除字节增量维护，
+// 写任务空闲时定期与 usedBytes() 对账。FAT32 上 usedBytes() 可能要扫描 FAT，不能放在热路径
+static std::atomic<int32_t> g_free_kb{0};
+static volatile uint32_t g_space_sync_ms = 0;
+
+static void space_reconcile(){
+  if(SD.cardType()==CARD_NONE){ g_free_kb.store(0); return; }
+  uint64_t free = SD.totalBytes() - SD.usedBytes();
+  g_free_kb.store((int32_t)(free / 1024));
+  g_space_sync_ms = millis();
+}
+
+static uint32_t space_round_kb(uint32_t bytes){
+  uint32_t units = (bytes + ASYNC_SD_SPACE_ALLOC_UNIT - 1) / ASYNC_SD_SPACE_ALLOC_UNIT;
+  return units * (ASYNC_SD_SPACE_ALLOC_UNIT / 1024);
+}
+
+void sd_async_note_written(uint32_t bytes){ g_free_kb.fetch_sub((int32_t)space_round_kb(bytes)); }
+void sd_async_note_deleted(uint32_t bytes){ g_free_kb.fetch_add((int32_t)space_round_kb(bytes)); }
+void sd_async_seed_free_kb(uint32_t kb){ g_free_kb.store((int32_t)kb); g_space_sync_ms = millis(); }
+
+uint32_t sd_async_free_kb(){
+  int32_t kb = g_free_kb.load(std::memory_order_relaxed);
+  return kb > 0 ? (uint32_t)kb : 0;
+}
+
+bool sd_async_space_ok(uint32_t len){
+  return sd_async_free_kb() >= (uint32_t)SD_MIN_FREE_MB * 1024 + space_round_kb(len);
+}
+
+static volatile uint8_t g_out_mode = ASYNC_SD_OUTPUT_MODE;
+
+void sd_async_set_output_mode(SdOutputMode m){ g_out_mode = m; }
+SdOutputMode sd_async_get_output_mode(){ return (SdOutputMode)g_out_mode; }
 
 #if !ASYNC_SD_ENABLE
 // 关闭时提供空实现
 bool sd_async_init(){ return true; }
 bool sd_async_start(){ return true; }
 void sd_async_stop(bool){ }
-bool sd_async_on_sd_ready(){ return true; }
+bool sd_async_on_sd_ready(){ space_reconcile(); return true; }
 void sd_async_on_sd_lost(){ }
-bool sd_async_submit(const char*, const uint8_t*, size_t, uint32_t){ return false; }
+SdTicket sd_async_submit(const char*, const uint8_t*, size_t, uint32_t, const SdFileMeta*){ return 0; }
+SdTicket sd_async_submit_fb(const char*, camera_fb_t*, uint32_t, const SdFileMeta*){ return 0; }
+SdTicket sd_async_submit_v(const char*, const SdIov*, uint8_t, camera_fb_t*, uint32_t, const SdFileMeta*, uint8_t){ return 0; }
+bool sd_async_submit_index(const PhotoIndexRec& rec, uint32_t){ PhotoIndexRec r = rec; return sd_index_append(r); }
+SdTicket sd_async_last_ticket(){ return 0; }
+SdWriteStatus sd_async_poll(SdTicket){ return SDW_UNKNOWN; }
+SdWriteStatus sd_async_wait(SdTicket, uint32_t){ return SDW_UNKNOWN; }
 bool sd_async_flush(uint32_t){ return true; }
+void sd_async_release_fbs(){ }
 void sd_async_get_stats(SdAsyncStats& out){ memset(&out,0,sizeof(out)); }
 bool sd_async_idle(){ return true; }
 #else
 
-struct PoolBlk {
-  PoolBlk* next;
-  size_t   cap;
-  size_t   len;
-  uint8_t  data[0];
+// 写会话：is_first 打开（截断）文件，随后各块经同一句柄追加，JOB_CLOSE 写完本块后关闭
+enum JobOp : uint8_t {
+  JOB_APPEND = 0,     // 追加本块，保持文件打开
+  JOB_CLOSE  = 1,     // 追加本块（若有）后关闭文件
+  JOB_INDEX  = 2,     // 环形区内为一条 PhotoIndexRec，按序追加进索引
 };
 
 struct Job {
+  uint8_t  op;
   char     path[ASYNC_SD_MAX_PATH];
-  PoolBlk* blk;
-  bool     is_first;  // 第一块：会先 remove 旧文件
+  const uint8_t* data;  // 环形区内的拷贝数据，或指向 fb->buf 内
+  uint32_t len;
+  uint32_t file_len;  // 整个文件字节数（段容器写帧头用）
+  uint32_t span;      // 占用环形区字节数（含回绕跳过的尾部），释放时归还；零拷贝段为 0
+  camera_fb_t* fb;    // 非空：写完后释放该帧的引用
+  bool     is_first;  // 第一块：打开新会话
+  bool     has_meta;  // 关闭成功后追加索引记录
+  bool     crc_trailer;  // 关闭前追加 FrameTrailer
+  SdTicket ticket;    // 所属文件的凭据；JOB_CLOSE 完成时公布结果
+  SdFileMeta meta;
+  uint32_t t_pub_us;  // 发布时刻（esp_timer 低 32 位），用于统计驻留时间
 };
 
-static QueueHandle_t  g_q = nullptr;
+// 除最后一块外，各块均按扇区对齐追加
+static_assert(ASYNC_SD_MAX_CHUNK % 512 == 0, "chunk must be sector aligned");
+// 单块不超过半个环形区，保证队列排空后总能预留成功
+static_assert(ASYNC_SD_MAX_CHUNK * 2 <= ASYNC_SD_ARENA_SIZE, "chunk too large for arena");
+
+// 单生产者/单消费者：只允许一个任务提交（采集任务），写任务为唯一消费者。
+// 生产者只写 head/in，消费者只写 tail/out，无锁；统计读取只做原子加载。
+static_assert((ASYNC_SD_QUEUE_LENGTH & (ASYNC_SD_QUEUE_LENGTH - 1)) == 0,
+              "queue length must be a power of two");
+
+static Job g_jobs[ASYNC_SD_QUEUE_LENGTH];
+static std::atomic<uint32_t> g_jhead{0};   // 已发布的作业数（生产者）
+static std::atomic<uint32_t> g_jtail{0};   // 已完成的作业数（写任务）
+
 static TaskHandle_t   g_task = nullptr;
-static SemaphoreHandle_t g_mtx = nullptr;
+static SemaphoreHandle_t g_space = nullptr; // 写任务释放空间后唤醒等待中的生产者
+
+// 凭据：文件按提交顺序写完，g_done 之前（含）的凭据均已有结果
+static_assert((ASYNC_SD_RESULT_SLOTS & (ASYNC_SD_RESULT_SLOTS - 1)) == 0,
+              "result slots must be a power of two");
+static const EventBits_t EVT_JOB_DONE = BIT0;
+static const EventBits_t EVT_TASK_EXIT = BIT1;  // 写任务收尾完毕即将删除自身
+static EventGroupHandle_t g_evt = nullptr;  // 写任务每完成一个作业置位
+static SdTicket g_ticket_seq = 0;           // 最近分配的凭据（生产者）
+static SdTicket g_last_ticket = 0;          // 最近整个文件都已发布的凭据（生产者）；中途失败的凭据不会有结果
+static std::atomic<uint32_t> g_done{0};     // 最近完成的凭据（写任务）
+static std::atomic<uint32_t> g_res_ticket[ASYNC_SD_RESULT_SLOTS];
+static uint8_t  g_res_status[ASYNC_SD_RESULT_SLOTS];
+static bool     g_file_fail = false;        // 当前文件已有块失败（写任务）
 
-static PoolBlk** g_pool = nullptr;     // 便于统计
-static PoolBlk*  g_free = nullptr;
-static uint32_t  g_pool_total = 0;
+// 环形区：帧按提交顺序首尾相接存放，写任务按 FIFO 顺序释放
+// g_arena_in/out 为累计预留/释放字节数，差值即占用量（无符号回绕安全）
+static uint8_t*  g_arena = nullptr;
+static uint32_t  g_pool_total = 0;      // 环形区字节数
+static uint32_t  g_arena_off = 0;       // 下一次预留的偏移（生产者私有）
+static std::atomic<uint32_t> g_arena_in{0};
+static std::atomic<uint32_t> g_arena_out{0};
+static std::atomic<uint32_t> g_arena_pad{0};  // 当前因回绕跳过的尾部字节
+static volatile uint32_t g_arena_hwm = 0;
+static volatile uint32_t g_arena_wraps = 0;
 
 static volatile bool g_running = false;
+static volatile bool g_fb_abort = false;     // 放弃引用帧缓冲的段（等待 deinit 时）
 static volatile bool g_sd_ready = false;
 static volatile uint32_t g_enq_ok = 0;
 static volatile uint32_t g_enq_drop = 0;
 static volatile uint32_t g_wr_ok = 0;
 static volatile uint32_t g_wr_fail = 0;
 static volatile uint32_t g_q_max = 0;
-static volatile bool g_writer_busy = false;
+static volatile uint32_t g_submit_us_max = 0;
+static volatile uint32_t g_submit_us_sum = 0;
+static volatile uint32_t g_submit_n = 0;
+static volatile uint32_t g_idx_skip = 0;
+static volatile uint32_t g_bytes_written = 0;
+static volatile uint32_t g_write_ms = 0;     // 写任务累计耗时（含 open/close）
+static volatile uint32_t g_file_opens = 0;
+
+// 当前写会话（仅写任务访问）
+static File     g_file;
+static char     g_file_path[ASYNC_SD_MAX_PATH] = {0};
+static bool     g_file_err = false;
+static uint32_t g_file_last_ms = 0;
+static uint32_t g_file_bytes = 0;
+static uint32_t g_file_crc = 0;     // 写入数据的增量 CRC32
+static uint8_t  g_file_out = SD_OUT_FILES;  // 当前文件的输出目标（SdOutputMode）
+static RingFrame g_ring_frame;
 
 static void pool_init(){
-  g_pool_total = 0;
-  g_free = nullptr;
-  if(!g_pool){
-    g_pool = (PoolBlk**)calloc(ASYNC_SD_POOL_BLOCKS, sizeof(PoolBlk*));
-  }
-  for(uint32_t i=0;i<ASYNC_SD_POOL_BLOCKS;i++){
-    size_t alloc_size = sizeof(PoolBlk) + ASYNC_SD_POOL_BLOCK_SIZE;
-    void* mem = heap_caps_malloc(alloc_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if(!mem) mem = heap_caps_malloc(alloc_size, MALLOC_CAP_8BIT);
-    if(!mem){
- 
-      continue;
-    }
-    PoolBlk* b = (PoolBlk*)mem;
-    b->cap = ASYNC_SD_POOL_BLOCK_SIZE;
-    b->len = 0;
-    b->next = g_free;
-    g_free = b;
-    g_pool[i] = b;
-    g_pool_total++;
+  if(!g_arena){
+    g_arena = (uint8_t*)heap_caps_malloc(ASYNC_SD_ARENA_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if(!g_arena) return;
+    g_pool_total = ASYNC_SD_ARENA_SIZE;
   }
+  g_arena_off = 0;
+  g_arena_in.store(0);
+  g_arena_out.store(0);
+  g_arena_pad.store(0);
+}
+
+// 预留 len 字节的连续空间；尾部不足时跳到环首，跳过部分计入本次 span
+static bool pool_take(uint32_t len, Job& j){
+  uint32_t need = (len + 3) & ~3u;
+  uint32_t in   = g_arena_in.load(std::memory_order_relaxed);
+  uint32_t used = in - g_arena_out.load(std::memory_order_acquire);
+  uint32_t off  = g_arena_off;
+  uint32_t pad  = (off + need > g_pool_total) ? (g_pool_total - off) : 0;
+  if(used + pad + need > g_pool_total) return false;
+
+  if(pad){ off = 0; g_arena_pad.fetch_add(pad, std::memory_order_relaxed); g_arena_wraps++; }
+  j.data = g_arena + off;
+  j.len  = len;
+  j.span = pad + need;
+  g_arena_off = off + need;
+  if(g_arena_off >= g_pool_total) g_arena_off = 0;
+  g_arena_in.store(in + j.span, std::memory_order_relaxed);
+  used += j.span;
+  if(used > g_arena_hwm) g_arena_hwm = used;
+  return true;
 }
 
-static PoolBlk* pool_take(){
-  PoolBlk* b = nullptr;
-  xSemaphoreTake(g_mtx, portMAX_DELAY);
-  if(g_free){ b = g_free; g_free = g_free->next; b->next=nullptr; b->len=0; }
-  xSemaphoreGive(g_mtx);
-  return b;
+// 撤销尚未发布的预留（仅生产者调用；写任务只按已发布作业的 span 释放）
+static void pool_unreserve(uint32_t off0, uint32_t in0, uint32_t head, uint8_t n){
+  for(uint8_t i = 0; i < n; i++){
+    const Job& j = g_jobs[(head + i) & (ASYNC_SD_QUEUE_LENGTH - 1)];
+    if(!j.span) continue;
+    uint32_t pad = j.span - ((j.len + 3) & ~3u);
+    if(pad) g_arena_pad.fetch_sub(pad, std::memory_order_relaxed);
+  }
+  g_arena_off = off0;
+  g_arena_in.store(in0, std::memory_order_relaxed);
 }
 
-static void pool_give(PoolBlk* b){
-  if(!b) return;
-  xSemaphoreTake(g_mtx, portMAX_DELAY);
-  b->next = g_free; g_free = b;
-  xSemaphoreGive(g_mtx);
+// 写任务按提交顺序释放，因此只需归还 span
+static void pool_give(const Job& j){
+  if(!j.span) return;
+  uint32_t pad = j.span - ((j.len + 3) & ~3u);
+  if(pad) g_arena_pad.fetch_sub(pad, std::memory_order_relaxed);
+  g_arena_out.fetch_add(j.span, std::memory_order_release);
 }
 
 static uint32_t pool_free_count(){
-  uint32_t n=0;
-  xSemaphoreTake(g_mtx, portMAX_DELAY);
-  for(PoolBlk* p=g_free;p;p=p->next) n++;
-  xSemaphoreGive(g_mtx);
-  return n;
-}
-
-static bool q_send(Job& j, uint32_t timeout_ms){
-  if(!g_q) return false;
-  if(xQueueSend(g_q, &j, pdMS_TO_TICKS(timeout_ms)) == pdTRUE){
-    g_enq_ok++;
-    uint32_t depth = uxQueueMessagesWaiting(g_q);
-    if(depth > g_q_max) g_q_max = depth;
-    return true;
-  }else{
+  return g_pool_total - (g_arena_in.load(std::memory_order_relaxed) -
+                         g_arena_out.load(std::memory_order_relaxed));
+}
+
+static uint32_t ring_depth(){
+  return g_jhead.load(std::memory_order_acquire) - g_jtail.load(std::memory_order_acquire);
+}
+
+// 等待 cond 成立；写任务每释放一个作业 give 一次 g_space
+template<typename F>
+static bool wait_space(F cond, uint32_t timeout_ms){
+  if(cond()) return true;
+  uint32_t t0 = millis();
+  while(true){
+    uint32_t el = millis() - t0;
+    if(el >= timeout_ms) return false;
+    xSemaphoreTake(g_space, pdMS_TO_TICKS(timeout_ms - el));
+    if(cond()) return true;
+  }
+}
+
+// 取下一个空闲作业槽；生产者原地填写后调用 ring_publish()
+static Job* ring_acquire(uint32_t timeout_ms){
+  if(!wait_space([]{ return ring_depth() < ASYNC_SD_QUEUE_LENGTH; }, timeout_ms)){
     g_enq_drop++;
-    return false;
+    return nullptr;
+  }
+  Job* j = &g_jobs[g_jhead.load(std::memory_order_relaxed) & (ASYNC_SD_QUEUE_LENGTH - 1)];
+  *j = Job{};
+  return j;
+}
+
+static void ring_publish(){
+  g_jobs[g_jhead.load(std::memory_order_relaxed) & (ASYNC_SD_QUEUE_LENGTH - 1)].t_pub_us =
+      (uint32_t)esp_timer_get_time();
+  g_jhead.fetch_add(1, std::memory_order_release);
+  g_enq_ok++;
+  uint32_t depth = ring_depth();
+  if(depth > g_q_max) g_q_max = depth;
+  if(g_task) xTaskNotifyGive(g_task);
+}
+
+static SdTicket next_ticket(){
+  if(++g_ticket_seq == 0) g_ticket_seq = 1;
+  return g_ticket_seq;
+}
+
+// 写任务公布一个文件的结果：先写状态再发布凭据
+static void publish_result(SdTicket t, bool ok){
+  uint32_t i = t & (ASYNC_SD_RESULT_SLOTS - 1);
+  g_res_ticket[i].store(0, std::memory_order_relaxed);
+  g_res_status[i] = ok ? SDW_OK : SDW_FAIL;
+  g_res_ticket[i].store(t, std::memory_order_release);
+  g_done.store(t, std::memory_order_release);
+}
+
+// 等待 cond 成立；写任务每完成一个作业置位一次，先清位再复查避免丢唤醒
+template<typename F>
+static bool wait_done(F cond, uint32_t timeout_ms){
+  uint32_t t0 = millis();
+  while(true){
+    if(cond()) return true;
+    xEventGroupClearBits(g_evt, EVT_JOB_DONE);
+    if(cond()) return true;
+    uint32_t el = millis() - t0;
+    if(el >= timeout_ms) return false;
+    xEventGroupWaitBits(g_evt, EVT_JOB_DONE, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout_ms - el));
   }
 }
 
-static bool write_chunk(const char* path, const uint8_t* data, size_t len, bool is_first){
+static void note_submit_us(uint32_t t0){
+  uint32_t us = micros() - t0;
+  if(us > g_submit_us_max) g_submit_us_max = us;
+  g_submit_us_sum += us;
+  g_submit_n++;
+}
+
+static bool session_close(){
+  if(!g_file) return false;
+  uint32_t cc = perf_cc();
+  g_file.close();             // close 时一次性刷新数据与目录项
+  perf_record_cc(PS_SD_CLOSE, cc);
+  g_file_path[0] = '\0';
+  sd_async_note_written(g_file_bytes);
+  return !g_file_err;
+}
+
+static bool session_open(const char* path){
+  session_close();
+  g_file_err = false;
+  g_file_bytes = 0;
+  g_file_crc = 0;
   if(!g_sd_ready) return false;
-  if(is_first){
-    // 尽可能创建一个干净文件
-    SD.remove(path);
+  if(!sd_async_space_ok(0)) return false;
+  sd_index_prepare_dir(path);
+  // FILE_WRITE 会截断已有文件，无需先 remove
+  uint32_t cc = perf_cc();
+  g_file = SD.open(path, FILE_WRITE);
+  perf_record_cc(PS_SD_OPEN, cc);
+  if(!g_file) return false;
+  g_file_opens++;
+  strncpy(g_file_path, path, ASYNC_SD_MAX_PATH-1);
+  g_file_path[ASYNC_SD_MAX_PATH-1] = '\0';
+  return true;
+}
+
+// 段容器/循环槽会话：帧头写入当前段或领取下一个槽，后续块追加到同一帧
+static bool frame_open(const Job& j){
+  session_close();
+  g_file_err = false;
+  g_file_bytes = 0;
+  g_file_crc = 0;
+  g_file_path[0] = '\0';
+  if(!g_sd_ready) return false;
+  uint32_t cc = perf_cc();
+  bool ok = (g_file_out == SD_OUT_RING)
+            ? sd_ring_begin(g_ring_frame, j.meta.index, j.file_len, j.meta.ts, j.meta.trigger)
+            : sd_segment_begin(j.meta.index, j.file_len, j.meta.ts, j.meta.trigger);
+  perf_record_cc(PS_SD_OPEN, cc);
+  if(!ok) return false;
+  strncpy(g_file_path, j.path, ASYNC_SD_MAX_PATH-1);
+  g_file_path[ASYNC_SD_MAX_PATH-1] = '\0';
+  return true;
+}
+
+// 写入当前输出目标并累加 CRC
+static void out_write(const uint8_t* data, size_t len){
+  size_t w;
+  if(g_file_out == SD_OUT_RING)         w = sd_ring_append(g_ring_frame, data, len);
+  else if(g_file_out == SD_OUT_SEGMENT) w = sd_segment_append(data, len);
+  else                                  w = g_file.write(data, len);
+  g_bytes_written += w;
+  g_file_bytes += w;
+  g_file_crc = esp_rom_crc32_le(g_file_crc, data, w);
+  if(w != len) g_file_err = true;
+}
+
+static bool write_chunk(const Job& j){
+  const uint8_t* data = j.data;
+  size_t len = j.len;
+  if(j.op == JOB_INDEX){
+    PhotoIndexRec r;
+    memcpy(&r, data, sizeof(r));
+    sd_index_append(r);
+    return true;
+  }
+
+  if(j.is_first){
+    g_file_out = j.has_meta ? g_out_mode : SD_OUT_FILES;
+    if(!(g_file_out != SD_OUT_FILES ? frame_open(j) : session_open(j.path))) return false;
+  }else if((g_file_out == SD_OUT_FILES && !g_file) || strcmp(g_file_path, j.path) != 0){
+    // 会话已丢失（SD 掉线或首块失败），后续块无法续写
+    return false;
+  }
+  if(!g_sd_ready){ g_file_err = true; return false; }
+
+  if(len && !j.span && g_fb_abort){
+    g_file_err = true;        // 零拷贝段：驱动即将回收 fb，不再写
+  }else if(len){
+    uint32_t cc = perf_cc();
+    out_write(data, len);
+    perf_record_cc(PS_SD_WRITE, cc);
+  }
+  if(j.op == JOB_CLOSE && j.crc_trailer && !g_file_err){
+    FrameTrailer tr{ g_file_crc, FRAME_TRAILER_MAGIC };
+    out_write((const uint8_t*)&tr, sizeof(tr));
   }
-  File f = SD.open(path, FILE_WRITE);
-  if(!f){ return false; }
-  size_t w = f.write(data, len);
-  f.flush();
-  f.close();
-  return (w == len);
+  bool ok = !g_file_err;
+  if(j.op == JOB_CLOSE){
+    uint32_t size = g_file_bytes, crc = g_file_crc, off = 0;
+    char rpath[sizeof(PhotoIndexRec::path)];
+    bool fits = snprintf(rpath, sizeof(rpath), "%s", j.path) < (int)sizeof(rpath);
+    bool indexed = j.has_meta;
+    if(g_file_out == SD_OUT_RING){
+      ok = sd_ring_end(g_ring_frame, crc) && ok;
+      indexed = false;        // 槽头即索引
+      g_file_path[0] = '\0';
+    }else if(g_file_out == SD_OUT_SEGMENT){
+      ok = sd_segment_end(crc, off) && ok;
+      fits = snprintf(rpath, sizeof(rpath), "%s", sd_segment_path()) < (int)sizeof(rpath);
+      g_file_path[0] = '\0';
+    }else{
+      ok = session_close() && ok;
+    }
+    // 路径放不进索引记录时只写文件不入索引，截断的路径会指向不存在的文件
+    if(ok && indexed && !fits) g_idx_skip++;
+    else if(ok && indexed){
+      PhotoIndexRec r{};
+      r.index = j.meta.index;
+      r.size = size;
+      r.ts = j.meta.ts;
+      r.trigger = j.meta.trigger;
+      r.crc = crc;
+      r.offset = off;
+      memcpy(r.path, rpath, sizeof(r.path));
+      sd_index_append(r);
+    }
+  }
+  return ok;
 }
 
 static void writer_task(void*){
-  Job j{};
   while(g_running){
-    if(xQueueReceive(g_q, &j, pdMS_TO_TICKS(100)) != pdTRUE){
+    uint32_t tail = g_jtail.load(std::memory_order_relaxed);
+    if(g_jhead.load(std::memory_order_acquire) == tail){
+      // 丢失 JOB_CLOSE 时兜底关闭空闲会话
+      if(g_file && millis() - g_file_last_ms > ASYNC_SD_SESSION_IDLE_MS) session_close();
+      // 空闲时与文件系统对账剩余空间
+      if(!g_file && g_sd_ready && millis() - g_space_sync_ms > ASYNC_SD_SPACE_RECONCILE_MS) space_reconcile();
+      // 段文件：掉卡直接丢弃句柄，切离段模式时写尾部索引关闭，否则按帧数/时间刷新
+      if(!g_sd_ready) sd_segment_close(true);
+      else if(g_out_mode != SD_OUT_SEGMENT) sd_segment_close();
+      else sd_segment_idle();
+      // 循环录制：每轮补建一个槽，还有待建的就不睡，新作业到来即让路
+      if(g_sd_ready && g_out_mode == SD_OUT_RING && sd_ring_idle()) continue;
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
       continue;
     }
-    g_writer_busy = true;
-    bool ok = write_chunk(j.path, j.blk->data, j.blk->len, j.is_first);
+    // 原地处理，处理完才推进 tail，因此 tail==head 即表示空闲
+    Job& j = g_jobs[tail & (ASYNC_SD_QUEUE_LENGTH - 1)];
+    perf_record(PS_QUEUE, (uint32_t)esp_timer_get_time() - j.t_pub_us);
+    uint32_t t0 = millis();
+    bool ok = write_chunk(j);
+    g_file_last_ms = millis();
+    g_write_ms += g_file_last_ms - t0;
     if(ok) g_wr_ok++; else g_wr_fail++;
-    pool_give(j.blk);
-    g_writer_busy = false;
+    if(j.is_first) g_file_fail = false;
+    if(!ok) g_file_fail = true;
+    bool last = (j.op == JOB_CLOSE);
+    SdTicket t = j.ticket;
+    if(j.fb) fb_ref_release(j.fb);
+    pool_give(j);
+    g_jtail.store(tail + 1, std::memory_order_release);
+    if(last) publish_result(t, !g_file_fail);
+    xSemaphoreGive(g_space);
+    xEventGroupSetBits(g_evt, EVT_JOB_DONE);
   }
-  // drain 阶段由 stop() 控制
+  session_close();
+  sd_segment_close(!g_sd_ready);
+  // drain 阶段由 stop() 控制；此后不再消费队列，剩余作业由 release_fbs() 代为交还
+  g_task = nullptr;
+  xEventGroupSetBits(g_evt, EVT_TASK_EXIT);
   vTaskDelete(nullptr);
 }
 
+static void dump_stats(Print& out){
+  SdAsyncStats st;
+  sd_async_get_stats(st);
+  uint32_t bps = st.write_ms ? (uint32_t)((uint64_t)st.bytes_written * 1000 / st.write_ms) : 0;
+  out.printf("sd: %lu B/s, files=%lu, q=%lu/%lu, pool free=%lu hwm=%lu, idx_skip=%lu\n",
+             (unsigned long)bps, (unsigned long)st.file_opens,
+             (unsigned long)st.q_depth, (unsigned long)st.q_max,
+             (unsigned long)st.pool_free, (unsigned long)st.pool_hwm, (unsigned long)st.idx_skip);
+  SegStats sg;
+  sd_segment_get_stats(sg);
+  if(sg.frames) out.printf("seg: segments=%lu frames=%lu cur=%lu/%luB\n",
+                           (unsigned long)sg.segments, (unsigned long)sg.frames,
+                           (unsigned long)sg.cur_frames, (unsigned long)sg.cur_bytes);
+  RingStats rg;
+  sd_ring_get_stats(rg);
+  if(rg.frames || rg.mount_fail)
+    out.printf("ring: slots=%lu frames=%lu overwrites=%lu seq=%lu mount_fail=%lu\n",
+               (unsigned long)rg.slots, (unsigned long)rg.frames,
+               (unsigned long)rg.overwrites, (unsigned long)rg.seq, (unsigned long)rg.mount_fail);
+}
+
 bool sd_async_init(){
-  if(!g_mtx) g_mtx = xSemaphoreCreateMutex();
-  pool_init();
-  if(!g_q) g_q = xQueueCreate(ASYNC_SD_QUEUE_LENGTH, sizeof(Job));
-  return (g_mtx && g_q && g_pool_total>0);
+  perf_add_dump(dump_stats);
+  if(!g_space) g_space = xSemaphoreCreateBinary();
+  if(!g_evt) g_evt = xEventGroupCreate();
+  if(!g_task) pool_init();
+  return (g_space && g_evt && g_pool_total>0);
 }
 
 bool sd_async_start(){
@@ -154,29 +496,22 @@ bool sd_async_start(){
   BaseType_t rc = xTaskCreatePinnedToCore(writer_task, "sdw",
                                           ASYNC_SD_TASK_STACK, nullptr,
                                           ASYNC_SD_TASK_PRIO, &g_task,
-                                          tskNO_AFFINITY);
+                                          ASYNC_SD_TASK_CORE);
   return rc == pdPASS;
 }
 
 void sd_async_stop(bool drain){
   if(!g_task) return;
-  if(drain){
-    // 等待队列清空并且不在写
-    uint32_t t0 = millis();
-    while((uxQueueMessagesWaiting(g_q) > 0 || g_writer_busy) &&
-          (millis() - t0 < ASYNC_SD_FLUSH_TIMEOUT_MS)){
-      vTaskDelay(pdMS_TO_TICKS(10));
-    }
-  }
+  if(drain) sd_async_flush(ASYNC_SD_FLUSH_TIMEOUT_MS);
+  xEventGroupClearBits(g_evt, EVT_TASK_EXIT);
   g_running = false;
-  // 发送一个空唤醒
-  Job j{}; xQueueSend(g_q, &j, 0);
-  // 等待任务退出
-  vTaskDelay(pdMS_TO_TICKS(50));
-  g_task = nullptr;
+  xTaskNotifyGive(g_task);
+  // 等写任务写完当前一块、关闭会话后自行清空 g_task
+  xEventGroupWaitBits(g_evt, EVT_TASK_EXIT, pdTRUE, pdFALSE, pdMS_TO_TICKS(ASYNC_SD_FLUSH_TIMEOUT_MS));
 }
 
 bool sd_async_on_sd_ready(){
+  space_reconcile();
   g_sd_ready = true;
   return true;
 }
@@ -185,9 +520,12 @@ void sd_async_on_sd_lost(){
   g_sd_ready = false;
 }
 
-bool sd_async_submit(const char* path, const uint8_t* data, size_t len, uint32_t timeout_ms){
-  if(!path || !data || len==0) return false;
-  if(!g_q || !g_pool_total) return false;
+SdTicket sd_async_submit(const char* path, const uint8_t* data, size_t len, uint32_t timeout_ms,
+                         const SdFileMeta* meta){
+  if(!path || !data || len==0) return 0;
+  if(!g_space || !g_pool_total) return 0;
+  uint32_t t_in = micros();
+  SdTicket t = next_ticket();
 
   // 按块切分
   size_t remain = len;
@@ -195,44 +533,170 @@ bool sd_async_submit(const char* path, const uint8_t* data, size_t len, uint32_t
   bool   first  = true;
   while(remain){
     size_t chunk = remain;
-    if(chunk > ASYNC_SD_POOL_BLOCK_SIZE) chunk = ASYNC_SD_POOL_BLOCK_SIZE;
-
-    PoolBlk* b = pool_take();
-    if(!b){
-      // 池空：等待或丢弃（这里等待一个超时周期再尝试）
-      if(timeout_ms == 0) return false;
-      vTaskDelay(pdMS_TO_TICKS(timeout_ms));
-      b = pool_take();
-      if(!b) return false;
+    if(chunk > ASYNC_SD_MAX_CHUNK) chunk = ASYNC_SD_MAX_CHUNK;
+
+    Job* j = ring_acquire(timeout_ms);
+    if(!j) return 0;
+    // 环形区满：等待写任务释放，超时则丢弃
+    if(!wait_space([&]{ return pool_take(chunk, *j); }, timeout_ms)){
+      g_enq_drop++;
+      return 0;
     }
-    memcpy(b->data, data + offset, chunk);
-    b->len = chunk;
+    memcpy((uint8_t*)j->data, data + offset, chunk);
 
-    Job j{};
-    strncpy(j.path, path, ASYNC_SD_MAX_PATH-1);
-    j.path[ASYNC_SD_MAX_PATH-1] = '\0';
-    j.blk = b;
-    j.is_first = first;
+    j->op = (remain == chunk) ? JOB_CLOSE : JOB_APPEND;
+    j->file_len = len;
+    strncpy(j->path, path, ASYNC_SD_MAX_PATH-1);
+    j->path[ASYNC_SD_MAX_PATH-1] = '\0';
+    j->is_first = first;
+    j->ticket = t;
+    if(meta){ j->meta = *meta; j->has_meta = true; }
     first = false;
-
-    if(!q_send(j, timeout_ms)){
-      pool_give(b);
-      return false;
-    }
+    ring_publish();
 
     offset += chunk;
     remain -= chunk;
   }
-  return true;
+  note_submit_us(t_in);
+  g_last_ticket = t;
+  return t;
+}
+
+SdTicket sd_async_submit_fb(const char* path, camera_fb_t* fb, uint32_t timeout_ms,
+                            const SdFileMeta* meta){
+  if(!fb || !fb->buf || fb->len==0) return 0;
+  SdIov v{ fb->buf, (uint32_t)fb->len };
+  return sd_async_submit_v(path, &v, 1, fb, timeout_ms, meta);
+}
+
+// 先在 head 之后尚未发布的作业槽里原地填好全部段（拷贝段预留环形区），成功后一次性发布；
+// 中途超时则撤销预留，写任务看不到任何半个文件
+SdTicket sd_async_submit_v(const char* path, const SdIov* iov, uint8_t n, camera_fb_t* fb,
+                           uint32_t timeout_ms, const SdFileMeta* meta, uint8_t flags){
+  if(!path || !iov || n == 0 || n > ASYNC_SD_QUEUE_LENGTH) return 0;
+  if(!g_space) return 0;
+  uint32_t t_in = micros();
+  uint32_t total = 0, copy = 0;
+  int last_fb = -1;
+  for(uint8_t i = 0; i < n; i++){
+    bool in_fb = fb && iov[i].data >= fb->buf && iov[i].data + iov[i].len <= fb->buf + fb->len;
+    if(in_fb) last_fb = i;
+    else copy += iov[i].len;
+    total += iov[i].len;
+  }
+  if(total == 0 || copy > ASYNC_SD_MAX_CHUNK) return 0;
+  if(fb && last_fb < 0) return 0;   // 没有段引用 fb，写任务无从释放它
+  if(copy && !g_pool_total) return 0;
+
+  if(!wait_space([&]{ return ring_depth() + n <= ASYNC_SD_QUEUE_LENGTH; }, timeout_ms)){
+    g_enq_drop++;
+    return 0;
+  }
+  uint32_t head = g_jhead.load(std::memory_order_relaxed);
+  uint32_t off0 = g_arena_off, in0 = g_arena_in.load(std::memory_order_relaxed);
+  for(uint8_t i = 0; i < n; i++){
+    Job& j = g_jobs[(head + i) & (ASYNC_SD_QUEUE_LENGTH - 1)];
+    j = Job{};
+    if(fb && (int)i <= last_fb && iov[i].data >= fb->buf && iov[i].data + iov[i].len <= fb->buf + fb->len){
+      j.data = iov[i].data;
+      j.len = iov[i].len;
+      if((int)i == last_fb) j.fb = fb;
+    }else{
+      if(!wait_space([&]{ return pool_take(iov[i].len, j); }, timeout_ms)){
+        pool_unreserve(off0, in0, head, i);
+        g_enq_drop++;
+        return 0;
+      }
+      memcpy((uint8_t*)j.data, iov[i].data, iov[i].len);
+    }
+  }
+
+  SdTicket t = next_ticket();
+  for(uint8_t i = 0; i < n; i++){
+    Job& j = g_jobs[(head + i) & (ASYNC_SD_QUEUE_LENGTH - 1)];
+    j.op = (i == n - 1) ? JOB_CLOSE : JOB_APPEND;
+    j.file_len = total + ((flags & SD_SUBMIT_CRC_TRAILER) ? sizeof(FrameTrailer) : 0);
+    strncpy(j.path, path, ASYNC_SD_MAX_PATH-1);
+    j.path[ASYNC_SD_MAX_PATH-1] = '\0';
+    j.is_first = (i == 0);
+    j.crc_trailer = (flags & SD_SUBMIT_CRC_TRAILER) && i == n - 1;
+    j.ticket = t;
+    if(meta){ j.meta = *meta; j.has_meta = true; }
+    ring_publish();
+  }
+  note_submit_us(t_in);
+  g_last_ticket = t;
+  return t;
+}
+
+bool sd_async_submit_index(const PhotoIndexRec& rec, uint32_t timeout_ms){
+  PhotoIndexRec r = rec;
+  if(!g_space || !g_pool_total || ring_depth() == 0) return sd_index_append(r);
+  Job* j = ring_acquire(timeout_ms);
+  if(j && wait_space([&]{ return pool_take(sizeof(r), *j); }, timeout_ms)){
+    memcpy((uint8_t*)j->data, &r, sizeof(r));
+    j->op = JOB_INDEX;
+    ring_publish();
+    return true;
+  }
+  // 排不进队列：写任务按序处理，等最后提交的文件写完即可直接追加
+  if(sd_async_wait(g_last_ticket, timeout_ms) == SDW_PENDING) return false;
+  return sd_index_append(r);
+}
+
+SdTicket sd_async_last_ticket(){
+  return g_last_ticket;
+}
+
+SdWriteStatus sd_async_poll(SdTicket t){
+  if(t == 0) return SDW_UNKNOWN;
+  if((int32_t)(t - g_done.load(std::memory_order_acquire)) > 0) return SDW_PENDING;
+  uint32_t i = t & (ASYNC_SD_RESULT_SLOTS - 1);
+  if(g_res_ticket[i].load(std::memory_order_acquire) != t) return SDW_UNKNOWN;
+  uint8_t st = g_res_status[i];
+  // 读取期间被新结果覆盖则视为未知
+  if(g_res_ticket[i].load(std::memory_order_acquire) != t) return SDW_UNKNOWN;
+  return (SdWriteStatus)st;
+}
+
+SdWriteStatus sd_async_wait(SdTicket t, uint32_t timeout_ms){
+  if(!g_evt) return SDW_UNKNOWN;
+  SdWriteStatus st = SDW_PENDING;
+  wait_done([&]{ st = sd_async_poll(t); return st != SDW_PENDING; }, timeout_ms);
+  return st;
 }
 
 bool sd_async_flush(uint32_t timeout_ms){
-  uint32_t t0 = millis();
-  while((uxQueueMessagesWaiting(g_q) > 0 || g_writer_busy) &&
-        (millis() - t0 < timeout_ms)){
-    vTaskDelay(pdMS_TO_TICKS(10));
+  if(!g_evt) return true;
+  return wait_done([]{ return ring_depth() == 0; }, timeout_ms);
+}
+
+// 没有写任务时由调用方代为消费：交还各作业的 fb，所属文件记为失败
+static void drop_pending(){
+  uint32_t head = g_jhead.load(std::memory_order_acquire);
+  for(uint32_t tail = g_jtail.load(std::memory_order_relaxed); tail != head; tail++){
+    Job& j = g_jobs[tail & (ASYNC_SD_QUEUE_LENGTH - 1)];
+    if(j.op == JOB_INDEX) write_chunk(j);   // 文件已由同步路径写成，索引照常追加
+    else g_wr_fail++;
+    if(j.fb) fb_ref_release(j.fb);
+    pool_give(j);
+    g_jtail.store(tail + 1, std::memory_order_release);
+    if(j.op == JOB_CLOSE) publish_result(j.ticket, false);
+  }
+  xSemaphoreGive(g_space);
+  xEventGroupSetBits(g_evt, EVT_JOB_DONE);
+}
+
+void sd_async_release_fbs(){
+  if(!g_evt) return;
+  if(g_task){
+    if(sd_async_flush()) return;
+    g_fb_abort = true;
+    // 此时写任务至多还在写当前一块，之后的 fb 段直接跳过
+    while(g_task && !sd_async_flush()) {}
+    g_fb_abort = false;
   }
-  return (uxQueueMessagesWaiting(g_q) == 0 && !g_writer_busy);
+  if(!g_task && ring_depth()) drop_pending();
 }
 
 void sd_async_get_stats(SdAsyncStats& out){
@@ -240,17 +704,27 @@ void sd_async_get_stats(SdAsyncStats& out){
   out.enq_drop = g_enq_drop;
   out.write_ok = g_wr_ok;
   out.write_fail = g_wr_fail;
+  out.bytes_written = g_bytes_written;
+  out.write_ms = g_write_ms;
+  out.file_opens = g_file_opens;
+  out.free_kb = sd_async_free_kb();
   out.pool_total = g_pool_total;
   out.pool_free = pool_free_count();
-  out.q_depth = g_q ? uxQueueMessagesWaiting(g_q) : 0;
+  out.pool_hwm = g_arena_hwm;
+  out.pool_wasted = g_arena_pad.load(std::memory_order_relaxed);
+  out.pool_wraps = g_arena_wraps;
+  out.q_depth = ring_depth();
   out.q_max = g_q_max;
+  out.submit_us_max = g_submit_us_max;
+  out.submit_us_avg = g_submit_n ? g_submit_us_sum / g_submit_n : 0;
   out.running = g_running;
   out.sd_ready = g_sd_ready;
+  out.idx_skip = g_idx_skip;
   out.task_stack_min = g_task ? uxTaskGetStackHighWaterMark(g_task) : 0;
 }
 
 bool sd_async_idle(){
-  return (uxQueueMessagesWaiting(g_q) == 0 && !g_writer_busy);
+  return ring_depth() == 0;
 }
 
 #endif // ASYNC_SD_ENABLE
\ No newline at end of file
@@ -2,15 +2,59 @@
 #include <Arduino.h>
 #include "config.h"  
 
+struct PhotoIndexRec;
+
+// 提交凭据：每个文件一个，0 表示提交失败
+typedef uint32_t SdTicket;
+
+enum SdWriteStatus : uint8_t {
+  SDW_PENDING = 0,   // 尚未写完
+  SDW_OK      = 1,   // 已写入并关闭
+  SDW_FAIL    = 2,   // 写入失败
+  SDW_UNKNOWN = 3,   // 无效凭据，或结果已被新结果覆盖
+};
+
+enum SdOutputMode : uint8_t {
+  SD_OUT_FILES   = 0,   // 每张图片一个文件
+  SD_OUT_SEGMENT = 1,   // 带索引信息的图片追加进段容器文件
+  SD_OUT_RING    = 2,   // 带索引信息的图片循环覆盖预分配槽文件
+};
+
+// 分散提交的一段；位于 fb->buf 内的段零拷贝引用，其余段拷进环形区
+struct SdIov {
+  const uint8_t* data;
+  uint32_t len;
+};
+
+// sd_async_submit_v 标志
+#define SD_SUBMIT_CRC_TRAILER  0x01   // 文件末尾追加 FrameTrailer（此前全部字节的 CRC32，写任务增量计算）
+
+// 随文件提交的索引信息；写任务在文件成功关闭后追加索引记录
+struct SdFileMeta {
+  uint32_t index;
+  uint32_t ts;
+  uint8_t  trigger;
+};
+
 struct SdAsyncStats {
   uint32_t enq_ok = 0;
   uint32_t enq_drop = 0;
   uint32_t write_ok = 0;
   uint32_t write_fail = 0;
-  uint32_t pool_free = 0;
-  uint32_t pool_total = 0;
+  uint32_t bytes_written = 0;  // bytes_written / write_ms 即实际写入吞吐
+  uint32_t write_ms = 0;
+  uint32_t file_opens = 0;
+  uint32_t free_kb = 0;        // 缓存的剩余空间
+  uint32_t pool_free = 0;      // 环形区空闲字节
+  uint32_t pool_total = 0;     // 环形区总字节
+  uint32_t pool_hwm = 0;       // 占用峰值（字节）
+  uint32_t pool_wasted = 0;    // 当前因回绕跳过的尾部字节（碎片）
+  uint32_t pool_wraps = 0;     // 回绕次数
   uint32_t q_depth = 0;
   uint32_t q_max = 0;
+  uint32_t submit_us_max = 0;  // 提交耗时（含等待空间），写任务饱和时即反压延迟
+  uint32_t submit_us_avg = 0;
+  uint32_t idx_skip = 0;       // 路径超出 PhotoIndexRec::path，已写但未入索引
   uint32_t task_stack_min = 0; // 最小剩余栈
   bool     running = false;
   bool     sd_ready = false;
@@ -18,16 +62,59 @@ struct SdAsyncStats {
 
 bool sd_async_init();                      // 仅初始化数据结构（不启任务）
 bool sd_async_start();                     // 启动后台写任务
-void sd_async_stop(bool drain = true);     // 停止任务；drain=true会试着写完队列
+void sd_async_stop(bool drain = true);     // 停止任务并等其退出；drain=true会试着写完队列
 bool sd_async_on_sd_ready();               // SD挂载完成后调用（或在 start 之前已挂载）
 void sd_async_on_sd_lost();                // SD拔出/重挂前调用
 
-// 提交一个写任务（内部会处理大于池块的缓冲：按块切分并按顺序追加写）
-bool sd_async_submit(const char* path, const uint8_t* data, size_t len,
-                     uint32_t timeout_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS);
+// 以下提交接口仅允许单一任务调用（无锁单生产者环）
+// 提交一个写任务（拷贝进环形区；大于 ASYNC_SD_MAX_CHUNK 的缓冲按块切分并按顺序追加写）
+SdTicket sd_async_submit(const char* path, const uint8_t* data, size_t len,
+                         uint32_t timeout_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS,
+                         const SdFileMeta* meta = nullptr);
+
+// 零拷贝提交：写任务接管 fb，写完后由其 fb_ref_release()
+// 返回 0 时 fb 所有权仍归调用方
+SdTicket sd_async_submit_fb(const char* path, camera_fb_t* fb,
+                            uint32_t timeout_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS,
+                            const SdFileMeta* meta = nullptr);
+
+// 分散提交：各段按顺序写成一个文件，不拼接。fb 非空时位于 fb->buf 内的段零拷贝，
+// 写完最后一个这样的段后由写任务释放 fb（此时须至少有一段位于 fb->buf 内，否则返回 0）；
+// 其余段总长不超过 ASYNC_SD_MAX_CHUNK。
+// 所有作业一次性发布，返回 0 时没有任何段被提交，fb 所有权仍归调用方
+SdTicket sd_async_submit_v(const char* path, const SdIov* iov, uint8_t n, camera_fb_t* fb = nullptr,
+                           uint32_t timeout_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS,
+                           const SdFileMeta* meta = nullptr, uint8_t flags = 0);
+
+// 追加一条索引记录，排在已提交的文件之后由写任务写入，保证按序号顺序且不等写任务排空；
+// 队列空时直接追加，队列满时等最后提交的文件写完再追加
+bool sd_async_submit_index(const PhotoIndexRec& r, uint32_t timeout_ms = ASYNC_SD_SUBMIT_TIMEOUT_MS);
+
+// 最近一次成功提交的凭据（0=尚无）；写任务按提交顺序处理，等到它即等到此前提交的全部文件
+SdTicket sd_async_last_ticket();
+
+// 查询/等待某个文件的写入结果（最近 ASYNC_SD_RESULT_SLOTS 个凭据可查）
+SdWriteStatus sd_async_poll(SdTicket t);
+SdWriteStatus sd_async_wait(SdTicket t, uint32_t timeout_ms = ASYNC_SD_FLUSH_TIMEOUT_MS);
 
 // 等待队列清空
 bool sd_async_flush(uint32_t timeout_ms = ASYNC_SD_FLUSH_TIMEOUT_MS);
+// 等写任务交还全部帧缓冲（esp_camera_deinit 之前调用）：先正常排空，超时则跳过
+// 剩余引用 fb 的段（所属文件记为失败）并继续等到队列清空，不会带着在写的 fb 返回。
+// 写任务已停时直接交还队列中各作业的 fb，未写的文件记为失败
+void sd_async_release_fbs();
+
+// 剩余空间缓存：挂载时统计，之后按写入/删除增量维护并定期后台对账
+uint32_t sd_async_free_kb();
+bool sd_async_space_ok(uint32_t len);      // 写入 len 后仍满足 SD_MIN_FREE_MB（O(1)）
+void sd_async_note_written(uint32_t bytes);
+void sd_async_note_deleted(uint32_t bytes);
+// 用已知值（如深睡前缓存在 RTC 的值）代替挂载时的 usedBytes() 统计
+void sd_async_seed_free_kb(uint32_t kb);
+
+// 切换输出模式；从下一个文件开始生效
+void sd_async_set_output_mode(SdOutputMode m);
+SdOutputMode sd_async_get_output_mode();
 
 // 获取运行统计
 void sd_async_get_stats(SdAsyncStats& out);
@@ -0,0 +1,176 @@
+#include "sd_index.h"
+#include "config.h"
+#include <SD.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_rom_crc.h>
+
+static const uint32_t REC_SIZE = sizeof(PhotoIndexRec);
+
+static SemaphoreHandle_t g_idx_mtx = nullptr;
+static File     g_idx;            // 追加句柄，挂载期间常开
+static uint32_t g_idx_count = 0;
+static uint32_t g_idx_gen = 0;    // 每次打开（挂载/换卡）加一
+static char     g_last_dir[48] = {0};
+
+static uint32_t rec_crc(const PhotoIndexRec& r){
+  return esp_rom_crc32_le(0, (const uint8_t*)&r, offsetof(PhotoIndexRec, rec_crc));
+}
+
+static bool rec_valid(const PhotoIndexRec& r){
+  return r.magic == SD_INDEX_MAGIC && r.rec_crc == rec_crc(r);
+}
+
+static bool read_at(File& f, uint32_t pos, PhotoIndexRec& out){
+  if(!f.seek((size_t)pos * REC_SIZE)) return false;
+  if(f.read((uint8_t*)&out, REC_SIZE) != REC_SIZE) return false;
+  return rec_valid(out);
+}
+
+void sd_index_path(uint32_t index, char* out, size_t n){
+  snprintf(out, n, SD_INDEX_DIR "/%05lu/%08lu.jpg",
+           (unsigned long)(index / SD_INDEX_BUCKET), (unsigned long)index);
+}
+
+void sd_index_prepare_dir(const char* path){
+  const char* slash = strrchr(path, '/');
+  if(!slash || slash == path) return;
+  size_t n = slash - path;
+  if(n >= sizeof(g_last_dir) || !g_idx_mtx) return;
+  xSemaphoreTake(g_idx_mtx, portMAX_DELAY);
+  if(strncmp(g_last_dir, path, n) != 0 || g_last_dir[n] != '\0'){
+    char dir[sizeof(g_last_dir)];
+    for(size_t i = 1; i <= n; i++){
+      if(i < n && path[i] != '/') continue;
+      memcpy(dir, path, i); dir[i] = '\0';
+      if(!SD.exists(dir)) SD.mkdir(dir);
+    }
+    memcpy(g_last_dir, path, n); g_last_dir[n] = '\0';
+  }
+  xSemaphoreGive(g_idx_mtx);
+}
+
+bool sd_index_open(){
+  if(!g_idx_mtx) g_idx_mtx = xSemaphoreCreateMutex();
+  if(!g_idx_mtx) return false;
+  xSemaphoreTake(g_idx_mtx, portMAX_DELAY);
+  if(g_idx) g_idx.close();
+  g_last_dir[0] = '\0';    // 可能换了卡
+  if(!SD.exists(SD_INDEX_DIR)) SD.mkdir(SD_INDEX_DIR);
+  g_idx = SD.open(SD_INDEX_FILE, FILE_APPEND);
+  bool ok = (bool)g_idx;
+  g_idx_count = 0;
+  g_idx_gen++;
+  if(ok){
+    size_t sz = g_idx.size();
+    // 掉电留下的半条记录：补零到记录边界，该条因校验失败被忽略
+    if(sz % REC_SIZE){
+      static const uint8_t zeros[REC_SIZE] = {0};
+      g_idx.write(zeros, REC_SIZE - sz % REC_SIZE);
+      g_idx.flush();
+      sz += REC_SIZE - sz % REC_SIZE;
+    }
+    g_idx_count = sz / REC_SIZE;
+  }
+  xSemaphoreGive(g_idx_mtx);
+  return ok;
+}
+
+void sd_index_close(){
+  if(!g_idx_mtx) return;
+  xSemaphoreTake(g_idx_mtx, portMAX_DELAY);
+  if(g_idx) g_idx.close();
+  g_idx_count = 0;
+  xSemaphoreGive(g_idx_mtx);
+}
+
+bool sd_index_append(PhotoIndexRec& r){
+  if(!g_idx_mtx) return false;
+  r.magic = SD_INDEX_MAGIC;
+  r.rec_crc = rec_crc(r);
+  xSemaphoreTake(g_idx_mtx, portMAX_DELAY);
+  bool ok = false;
+  if(g_idx){
+    ok = g_idx.write((const uint8_t*)&r, REC_SIZE) == REC_SIZE;
+    g_idx.flush();              // 一条记录一次 sync，保证索引不落后于图片太多
+    if(ok) g_idx_count++;
+  }
+  xSemaphoreGive(g_idx_mtx);
+  return ok;
+}
+
+uint32_t sd_index_count(){
+  return g_idx_count;
+}
+
+bool sd_index_read(uint32_t pos, PhotoIndexRec& out){
+  if(!g_idx_mtx || pos >= g_idx_count) return false;
+  xSemaphoreTake(g_idx_mtx, portMAX_DELAY);
+  File f = SD.open(SD_INDEX_FILE, FILE_READ);
+  bool ok = f && read_at(f, pos, out);
+  if(f) f.close();
+  xSemaphoreGive(g_idx_mtx);
+  return ok;
+}
+
+uint32_t sd_index_read_many(uint32_t pos, PhotoIndexRec* out, uint32_t n, uint8_t* valid){
+  if(!g_idx_mtx || pos >= g_idx_count) return 0;
+  if(n > g_idx_count - pos) n = g_idx_count - pos;
+  xSemaphoreTake(g_idx_mtx, portMAX_DELAY);
+  File f = SD.open(SD_INDEX_FILE, FILE_READ);
+  uint32_t got = 0;
+  if(f && f.seek((size_t)pos * REC_SIZE)){
+    got = f.read((uint8_t*)out, (size_t)n * REC_SIZE) / REC_SIZE;
+    for(uint32_t i = 0; i < got; i++) valid[i] = rec_valid(out[i]);
+  }
+  if(f) f.close();
+  xSemaphoreGive(g_idx_mtx);
+  return got;
+}
+
+uint32_t sd_index_generation(){
+  return g_idx_gen;
+}
+
+bool sd_index_find(uint32_t index, PhotoIndexRec& out){
+  if(!g_idx_mtx || g_idx_count == 0) return false;
+  xSemaphoreTake(g_idx_mtx, portMAX_DELAY);
+  File f = SD.open(SD_INDEX_FILE, FILE_READ);
+  bool found = false;
+  if(f){
+    int32_t lo = 0, hi = (int32_t)g_idx_count - 1;
+    while(lo <= hi && !found){
+      int32_t mid = lo + (hi - lo) / 2;
+      // 坏记录向后跳过
+      int32_t p = mid;
+      while(p <= hi && !read_at(f, p, out)) p++;
+      if(p > hi){ hi = mid - 1; continue; }
+      if(out.index == index) found = true;
+      else if(out.index < index) lo = p + 1;
+      else hi = mid - 1;
+    }
+    f.close();
+  }
+  xSemaphoreGive(g_idx_mtx);
+  return found;
+}
+
+bool sd_index_tail_max(uint32_t& max_index){
+  if(!g_idx_mtx || g_idx_count == 0) return false;
+  xSemaphoreTake(g_idx_mtx, portMAX_DELAY);
+  File f = SD.open(SD_INDEX_FILE, FILE_READ);
+  bool found = false;
+  if(f){
+    uint32_t from = g_idx_count > SD_INDEX_TAIL_SCAN ? g_idx_count - SD_INDEX_TAIL_SCAN : 0;
+    PhotoIndexRec r;
+    for(uint32_t p = from; p < g_idx_count; p++){
+      if(!read_at(f, p, r)) continue;
+      if(!found || r.index > max_index) max_index = r.index;
+      found = true;
+    }
+    f.close();
+  }
+  xSemaphoreGive(g_idx_mtx);
+  return found;
+}
\ No newline at end of file
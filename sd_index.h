@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 图片按 SD_INDEX_BUCKET 张一个目录分桶存放：/img/00012/00012345.jpg
+// 另有仅追加的二进制索引文件，查找/列举/保留策略都走索引，不扫描目录
+
+#pragma pack(push,1)
+struct PhotoIndexRec{
+  uint32_t magic;      // SD_INDEX_MAGIC
+  uint32_t index;      // 图片序号（单调递增）
+  uint32_t size;       // 文件字节数
+  uint32_t ts;         // 保存时间（time()，未校时则为开机秒数）
+  uint8_t  trigger;    // TRIGGER_*
+  uint8_t  flags;
+  uint16_t reserved;
+  uint32_t crc;        // 图片数据 CRC32
+  uint32_t offset;     // 容器模式下帧记录在段文件内的偏移；独立文件为 0
+  char     path[32];   // 独立文件路径或所在段文件路径
+  uint32_t rec_crc;    // 本记录前面字段的 CRC32，用于识别掉电写坏的尾记录
+};
+#pragma pack(pop)
+static_assert(sizeof(PhotoIndexRec) == 64, "index record must stay 64 bytes");
+
+// 生成分桶路径
+void sd_index_path(uint32_t index, char* out, size_t n);
+
+// 确保 path 的父目录存在；缓存上次目录，通常每个桶只真正创建一次
+void sd_index_prepare_dir(const char* path);
+
+// 挂载后打开 / 掉卡前关闭索引文件
+bool sd_index_open();
+void sd_index_close();
+
+// 追加一条记录（补齐 magic/rec_crc）；线程安全
+bool sd_index_append(PhotoIndexRec& r);
+
+// 记录条数与按位置读取（含校验）
+uint32_t sd_index_count();
+bool sd_index_read(uint32_t pos, PhotoIndexRec& out);
+// 顺序批量读取，只打开一次文件；valid[i] 标记各条校验结果，返回读到的条数
+uint32_t sd_index_read_many(uint32_t pos, PhotoIndexRec* out, uint32_t n, uint8_t* valid);
+// 索引文件打开次数，换卡后变化，供缓存了记录位置的模块失效重建
+uint32_t sd_index_generation();
+
+// 按图片序号二分查找。依赖索引按序号递增追加：同步写的记录经写任务排队（见 sd_async_submit_index）
+bool sd_index_find(uint32_t index, PhotoIndexRec& out);
+
+// 只读尾部 SD_INDEX_TAIL_SCAN 条，返回其中最大的图片序号；启动恢复用，耗时与卡上文件数无关
+bool sd_index_tail_max(uint32_t& max_index);
\ No newline at end of file
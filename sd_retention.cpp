@@ -0,0 +1,192 @@
+#include "sd_retention.h"
+#include "sd_index.h"
+#include "sd_async.h"
+#include "perf_stats.h"
+#include <SD.h>
+#include <time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const uint32_t RET_READ_BATCH = 16;
+static const uint32_t TIME_VALID = 1600000000UL;   // 小于此值说明未校时
+
+static TaskHandle_t    g_ret_task = nullptr;
+static RetentionPolicy g_pol = { RETAIN_MAX_MB, RETAIN_MAX_DAYS, RETAIN_MAX_FILES, RETAIN_FREE_MARGIN_MB };
+static RetentionStats  g_ret = {};
+
+// 以下仅保留任务访问
+static uint32_t g_ret_gen = 0;       // 对应的索引代，变化说明换卡
+static uint32_t g_cursor = 0;        // 最旧未删除记录位置
+static uint32_t g_scan_pos = 0;      // 已计入 live 统计的记录位置
+static uint64_t g_live_bytes = 0;
+static uint32_t g_live_files = 0;
+// 多留一字节：记录里的 path 整段拷贝后补 '\0'，占满 32 字节时也不截断
+static char     g_last_removed[sizeof(PhotoIndexRec::path) + 1] = {0};
+static char     g_bucket[sizeof(PhotoIndexRec::path) + 1] = {0};   // 最近删除的照片所在桶目录
+
+static bool path_in(const char* path, const char* dir){
+  size_t n = strlen(dir);
+  return strncmp(path, dir, n) == 0 && path[n] == '/';
+}
+
+// 挂载后定位游标：删除总是从最旧开始，文件已不存在的记录构成前缀，二分即可
+static uint32_t find_cursor(){
+  uint32_t lo = 0, hi = sd_index_count();
+  PhotoIndexRec r;
+  while(lo < hi){
+    uint32_t mid = lo + (hi - lo) / 2;
+    if(sd_index_read(mid, r) && SD.exists(r.path)) hi = mid;
+    else lo = mid + 1;
+  }
+  return lo;
+}
+
+// 把新追加的记录计入 live 统计（增量，只读新增部分）
+static void scan_new(){
+  PhotoIndexRec recs[RET_READ_BATCH];
+  uint8_t valid[RET_READ_BATCH];
+  while(g_scan_pos < sd_index_count()){
+    uint32_t n = sd_index_read_many(g_scan_pos, recs, RET_READ_BATCH, valid);
+    if(!n) break;
+    for(uint32_t i = 0; i < n; i++){
+      if(!valid[i] || path_in(recs[i].path, SD_RING_DIR)) continue;
+      g_live_bytes += recs[i].size;
+      g_live_files++;
+    }
+    g_scan_pos += n;
+    vTaskDelay(1);
+  }
+}
+
+static bool over_policy(const RetentionPolicy& p, const PhotoIndexRec& oldest){
+  if(sd_async_free_kb() < (SD_MIN_FREE_MB + p.free_margin_mb) * 1024UL) return true;
+  if(p.max_files && g_live_files > p.max_files) return true;
+  if(p.max_mb && g_live_bytes > (uint64_t)p.max_mb * 1024 * 1024) return true;
+  if(p.max_days){
+    uint32_t now = (uint32_t)time(nullptr);
+    if(now > TIME_VALID && oldest.ts > TIME_VALID && now - oldest.ts > p.max_days * 86400UL) return true;
+  }
+  return false;
+}
+
+static void drop_live(const PhotoIndexRec& r){
+  if(g_live_files) g_live_files--;
+  g_live_bytes = g_live_bytes > r.size ? g_live_bytes - r.size : 0;
+}
+
+// 删除一条记录对应的文件；段文件一次删掉整段，其后同段记录只推进游标
+static void remove_rec(const PhotoIndexRec& r){
+  bool seg = path_in(r.path, SD_SEGMENT_DIR);
+  uint32_t freed = seg ? SD_SEGMENT_MAX_BYTES : r.size;
+  uint32_t t0 = micros();
+  bool ok = SD.remove(r.path);
+  uint32_t us = micros() - t0;
+  perf_record(PS_RET_DELETE, us);
+  g_ret.delete_us_total += us;
+  if(us > g_ret.delete_us_max) g_ret.delete_us_max = us;
+  if(!sd_async_idle()) g_ret.collisions++;
+  if(ok){
+    g_ret.files_deleted++;
+    g_ret.bytes_deleted_kb += freed / 1024;
+    sd_async_note_deleted(freed);
+  }else if(SD.exists(r.path)){
+    g_ret.delete_fail++;
+  }
+  memcpy(g_last_removed, r.path, sizeof(r.path));
+  g_last_removed[sizeof(r.path)] = '\0';
+  if(!seg){
+    memcpy(g_bucket, r.path, sizeof(r.path));
+    g_bucket[sizeof(r.path)] = '\0';
+    char* slash = strrchr(g_bucket, '/');
+    if(slash && slash != g_bucket) *slash = '\0';
+    else g_bucket[0] = '\0';
+  }
+}
+
+// 游标移到另一目录的记录上即离开了该桶：桶内记录都已处理（含缺号、写失败的空位），移除空目录
+static void leave_bucket(const char* next_path){
+  if(!g_bucket[0] || path_in(next_path, g_bucket)) return;
+  SD.rmdir(g_bucket);
+  g_bucket[0] = '\0';
+}
+
+// 返回本轮删除的文件数
+static uint32_t retention_step(){
+  uint32_t gen = sd_index_generation();
+  if(gen != g_ret_gen){
+    g_ret_gen = gen;
+    g_cursor = find_cursor();
+    g_scan_pos = g_cursor;
+    g_live_bytes = 0;
+    g_live_files = 0;
+    g_last_removed[0] = '\0';
+    g_bucket[0] = '\0';
+  }
+  scan_new();
+  RetentionPolicy p = g_pol;
+  uint32_t removed = 0;
+  while(removed < RETAIN_BATCH && g_cursor < g_scan_pos){
+    PhotoIndexRec r;
+    if(!sd_index_read(g_cursor, r)){ g_cursor++; continue; }   // 坏记录未计入 live
+    leave_bucket(r.path);
+    if(path_in(r.path, SD_RING_DIR)){ g_cursor++; continue; } // 槽文件由循环录制自行覆盖
+    if(strncmp(r.path, g_last_removed, sizeof(r.path)) == 0){ drop_live(r); g_cursor++; continue; }
+    if(!over_policy(p, r)) break;
+    if(!sd_async_idle()) break;                                // 写任务优先
+    if(path_in(r.path, SD_SEGMENT_DIR)){
+      // 最新记录仍在该段时段可能未关闭，不删
+      PhotoIndexRec last;
+      if(!sd_index_read(g_scan_pos - 1, last) || strcmp(last.path, r.path) == 0) break;
+    }
+    remove_rec(r);
+    drop_live(r);
+    g_cursor++;
+    removed++;
+    vTaskDelay(pdMS_TO_TICKS(RETAIN_SLICE_MS));
+  }
+  g_ret.live_files = g_live_files;
+  g_ret.live_kb = (uint32_t)(g_live_bytes / 1024);
+  g_ret.cursor = g_cursor;
+  return removed;
+}
+
+static void retention_task(void*){
+  while(true){
+    uint32_t removed = 0;
+    if(SD.cardType() != CARD_NONE && sd_async_get_output_mode() != SD_OUT_RING) removed = retention_step();
+    vTaskDelay(pdMS_TO_TICKS(removed >= RETAIN_BATCH ? RETAIN_SLICE_MS : RETAIN_POLL_MS));
+  }
+}
+
+static void dump_stats(Print& out){
+  RetentionStats rt;
+  sd_retention_get_stats(rt);
+  out.printf("retain: live=%lu/%luKB deleted=%lu/%luKB in %lums max=%luus fail=%lu coll=%lu\n",
+             (unsigned long)rt.live_files, (unsigned long)rt.live_kb,
+             (unsigned long)rt.files_deleted, (unsigned long)rt.bytes_deleted_kb,
+             (unsigned long)(rt.delete_us_total / 1000), (unsigned long)rt.delete_us_max,
+             (unsigned long)rt.delete_fail, (unsigned long)rt.collisions);
+}
+
+bool sd_retention_start(){
+  perf_add_dump(dump_stats);
+#if RETAIN_ENABLE
+  if(g_ret_task) return true;
+  return xTaskCreatePinnedToCore(retention_task, "sdret", RETAIN_TASK_STACK, nullptr,
+                                 RETAIN_TASK_PRIO, &g_ret_task, RETAIN_TASK_CORE) == pdPASS;
+#else
+  return true;
+#endif
+}
+
+void sd_retention_set_policy(const RetentionPolicy& p){
+  g_pol = p;
+}
+
+void sd_retention_get_policy(RetentionPolicy& out){
+  out = g_pol;
+}
+
+void sd_retention_get_stats(RetentionStats& out){
+  out = g_ret;
+}
\ No newline at end of file
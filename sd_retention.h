@@ -0,0 +1,32 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 保留策略：后台低优先级任务沿索引从最旧记录开始删除，直到满足
+// 剩余空间下限与可选的容量/天数/文件数上限。只在写任务队列为空时删除，
+// 每删一个让出 RETAIN_SLICE_MS，单次删除耗时即对并发写入的最大附加延迟。
+// 循环录制模式（SD_OUT_RING）下不需要也不运行。
+
+struct RetentionPolicy {
+  uint32_t max_mb;          // 照片总字节上限（MB）
+  uint32_t max_days;        // 最长保留天数（需已校时）
+  uint32_t max_files;       // 最多保留文件数
+  uint32_t free_margin_mb;  // 剩余空间低于 SD_MIN_FREE_MB + 此值时删除
+};
+
+struct RetentionStats {
+  uint32_t files_deleted;
+  uint32_t bytes_deleted_kb;
+  uint32_t delete_fail;
+  uint64_t delete_us_total; // files_deleted / delete_us_total 即删除吞吐（逐次累加微秒，不截断）
+  uint32_t delete_us_max;
+  uint32_t collisions;      // 删除期间有写作业到达的次数（这些作业最多多等 delete_us_max）
+  uint32_t live_files;
+  uint32_t live_kb;
+  uint32_t cursor;          // 最旧未删除记录在索引中的位置
+};
+
+bool sd_retention_start();
+void sd_retention_set_policy(const RetentionPolicy& p);
+void sd_retention_get_policy(RetentionPolicy& out);
+void sd_retention_get_stats(RetentionStats& out);
\ No newline at end of file
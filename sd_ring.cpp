@@ -0,0 +1,259 @@
+#include "sd_ring.h"
+#include "sd_async.h"
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_rom_crc.h>
+
+static_assert(sizeof(RingSlotHdr) <= SD_RING_DATA_OFF, "slot header too large");
+static_assert(SD_RING_SLOTS > 1 && SD_RING_SLOTS <= 10000, "bad slot count");
+
+static SemaphoreHandle_t g_ring_mtx = nullptr;
+static bool      g_ring_ready = false;
+static uint16_t  g_ring_have = 0;     // 已建好的槽 [0, have)
+static uint16_t  g_ring_next = 0;     // 下一个要覆盖的槽（最旧）
+static uint32_t  g_ring_seq = 0;      // 最近分配的写入序号
+static uint32_t  g_grow_retry_ms = 0; // 补建停下后的下次尝试时刻，0=未停
+static uint32_t  g_mount_backoff_ms = 0;
+static uint32_t  g_mount_retry_ms = 0;
+static RingStats g_ring_stats = {};
+
+// 深睡保留：最近一次写成的槽与序号，唤醒后核对该槽头
+static const uint32_t RTC_RING_MAGIC = 0x52474E52UL;
+RTC_NOINIT_ATTR static uint32_t rtc_ring_magic;
+RTC_NOINIT_ATTR static uint16_t rtc_ring_have;
+RTC_NOINIT_ATTR static uint16_t rtc_ring_slot;
+RTC_NOINIT_ATTR static uint32_t rtc_ring_seq;
+
+static uint32_t hdr_crc(const RingSlotHdr& h){
+  return esp_rom_crc32_le(0, (const uint8_t*)&h, offsetof(RingSlotHdr, hdr_crc));
+}
+
+static bool read_hdr(File& f, RingSlotHdr& h){
+  if(f.read((uint8_t*)&h, sizeof(h)) != sizeof(h)) return false;
+  return h.magic == SD_RING_MAGIC && h.hdr_crc == hdr_crc(h);
+}
+
+void sd_ring_slot_path(uint16_t slot, char* out, size_t n){
+  snprintf(out, n, SD_RING_DIR "/R%04u.bin", (unsigned)slot);
+}
+
+// 新建定长槽文件：写入末字节即分配整条簇链，槽头为全零（无效）
+static bool slot_create(const char* path){
+  File f = SD.open(path, FILE_WRITE);
+  if(!f) return false;
+  static const uint8_t zeros[sizeof(RingSlotHdr)] = {0};
+  bool ok = f.write(zeros, sizeof(zeros)) == sizeof(zeros) &&
+            f.seek(SD_RING_SLOT_BYTES - 1) && f.write((uint8_t)0) == 1;
+  f.close();
+  if(ok) sd_async_note_written(SD_RING_SLOT_BYTES);
+  return ok;
+}
+
+static void rtc_save(uint16_t slot, uint32_t seq){
+  rtc_ring_have = g_ring_have;
+  rtc_ring_slot = slot;
+  rtc_ring_seq = seq;
+  rtc_ring_magic = RTC_RING_MAGIC;
+}
+
+static bool rtc_restore(){
+  if(rtc_ring_magic != RTC_RING_MAGIC || !rtc_ring_have || rtc_ring_have > SD_RING_SLOTS ||
+     rtc_ring_slot >= rtc_ring_have) return false;
+  RingSlotHdr h;
+  if(!sd_ring_read_hdr(rtc_ring_slot, h) || h.seq != rtc_ring_seq) return false;   // 换卡或掉电
+  g_ring_have = rtc_ring_have;
+  g_ring_next = (rtc_ring_slot + 1) % g_ring_have;
+  g_ring_seq = rtc_ring_seq;
+  return true;
+}
+
+// 从槽 0 起扫描连续存在的槽；缺口之后的槽由补建时重建
+static bool scan_slots(){
+  if(!SD.exists(SD_RING_DIR)) SD.mkdir(SD_RING_DIR);
+  uint32_t best_seq = 0;
+  uint16_t best = 0, have = 0;
+  bool any = false;
+  char path[32];
+  for(; have < SD_RING_SLOTS; have++){
+    sd_ring_slot_path(have, path, sizeof(path));
+    File f = SD.open(path, FILE_READ);
+    if(!f || f.size() < SD_RING_SLOT_BYTES){ if(f) f.close(); break; }
+    RingSlotHdr h;
+    if(read_hdr(f, h) && (!any || (int32_t)(h.seq - best_seq) > 0)){
+      best_seq = h.seq; best = have; any = true;
+    }
+    f.close();
+  }
+  while(have < SD_RING_MOUNT_SLOTS && sd_async_space_ok(SD_RING_SLOT_BYTES)){
+    sd_ring_slot_path(have, path, sizeof(path));
+    if(!slot_create(path)) break;
+    have++;
+    g_ring_stats.created++;
+  }
+  if(!have) return false;
+  g_ring_have = have;
+  g_ring_next = any ? (best + 1) % have : 0;
+  g_ring_seq = best_seq;
+  if(any) rtc_save(best, best_seq);
+  return true;
+}
+
+bool sd_ring_mount(){
+  if(!g_ring_mtx) g_ring_mtx = xSemaphoreCreateMutex();
+  if(!g_ring_mtx) return false;
+  xSemaphoreTake(g_ring_mtx, portMAX_DELAY);
+  g_ring_ready = false;
+  g_ring_stats.created = 0;
+  bool ok = rtc_restore() || scan_slots();
+  if(ok){
+    g_ring_stats.slots = g_ring_have;
+    g_ring_stats.seq = g_ring_seq;
+    g_grow_retry_ms = 0;
+    g_mount_backoff_ms = 0;
+    g_ring_ready = true;
+  }else{
+    g_ring_stats.mount_fail++;
+    g_mount_backoff_ms = g_mount_backoff_ms ? min<uint32_t>(g_mount_backoff_ms * 2, SD_RING_MOUNT_BACKOFF_MAX_MS)
+                                            : SD_RING_MOUNT_BACKOFF_MS;
+    g_mount_retry_ms = millis() + g_mount_backoff_ms;
+  }
+  xSemaphoreGive(g_ring_mtx);
+  return ok;
+}
+
+bool sd_ring_idle(){
+  if(!g_ring_ready || g_ring_have >= SD_RING_SLOTS) return false;
+  if(g_grow_retry_ms && (int32_t)(millis() - g_grow_retry_ms) < 0) return false;
+  xSemaphoreTake(g_ring_mtx, portMAX_DELAY);
+  bool more = false;
+  if(g_ring_ready && g_ring_have < SD_RING_SLOTS){
+    char path[32];
+    sd_ring_slot_path(g_ring_have, path, sizeof(path));
+    if(sd_async_space_ok(SD_RING_SLOT_BYTES) && slot_create(path)){
+      g_ring_have++;
+      g_ring_stats.slots = g_ring_have;
+      g_ring_stats.created++;
+      if(rtc_ring_magic == RTC_RING_MAGIC) rtc_ring_have = g_ring_have;
+      g_grow_retry_ms = 0;
+      more = g_ring_have < SD_RING_SLOTS;
+    }else{
+      g_grow_retry_ms = millis() + SD_RING_GROW_RETRY_MS;
+      if(!g_grow_retry_ms) g_grow_retry_ms = 1;
+    }
+  }
+  xSemaphoreGive(g_ring_mtx);
+  return more;
+}
+
+void sd_ring_unmount(){
+  if(!g_ring_mtx) return;
+  xSemaphoreTake(g_ring_mtx, portMAX_DELAY);
+  g_ring_ready = false;
+  xSemaphoreGive(g_ring_mtx);
+}
+
+bool sd_ring_begin(RingFrame& rf, uint32_t index, uint32_t len, uint32_t ts, uint8_t trigger){
+  if(rf.f) rf.f.close();              // 上一帧未收尾：槽头未更新，该槽按旧头校验失败
+  if(len > SD_RING_SLOT_BYTES - SD_RING_DATA_OFF) return false;
+  if(!g_ring_ready){
+    // 挂载失败后退避：热路径和唤醒路径上不每帧重扫/重建
+    if(g_mount_backoff_ms && (int32_t)(millis() - g_mount_retry_ms) < 0) return false;
+    if(!sd_ring_mount()) return false;
+  }
+  xSemaphoreTake(g_ring_mtx, portMAX_DELAY);
+  rf.slot = g_ring_next;
+  rf.seq = ++g_ring_seq;
+  g_ring_next = (g_ring_next + 1) % g_ring_have;   // 补建中新加的槽在回绕前轮到
+  xSemaphoreGive(g_ring_mtx);
+
+  char path[32];
+  sd_ring_slot_path(rf.slot, path, sizeof(path));
+  rf.f = SD.open(path, "r+");        // 原地覆盖，不截断
+  if(!rf.f) return false;
+  // 补建中的新槽与掉电作废的槽头无效，只有覆盖有效旧帧才计入 overwrites
+  RingSlotHdr old;
+  bool had = read_hdr(rf.f, old);
+  // 先作废旧头再覆盖数据：FatFs 换扇区前写回，旧头不会与半新数据并存
+  static const uint8_t zeros[sizeof(RingSlotHdr)] = {0};
+  if(!rf.f.seek(0) || rf.f.write(zeros, sizeof(zeros)) != sizeof(zeros) || !rf.f.seek(SD_RING_DATA_OFF)){
+    rf.f.close();
+    return false;
+  }
+  if(had){
+    xSemaphoreTake(g_ring_mtx, portMAX_DELAY);
+    g_ring_stats.overwrites++;
+    xSemaphoreGive(g_ring_mtx);
+  }
+  rf.index = index;
+  rf.len = len;
+  rf.ts = ts;
+  rf.trigger = trigger;
+  rf.written = 0;
+  return true;
+}
+
+size_t sd_ring_append(RingFrame& rf, const uint8_t* data, size_t len){
+  if(!rf.f) return 0;
+  if(rf.written + len > rf.len) len = rf.len - rf.written;
+  size_t w = rf.f.write(data, len);
+  rf.written += w;
+  return w;
+}
+
+bool sd_ring_end(RingFrame& rf, uint32_t crc){
+  if(!rf.f) return false;
+  bool ok = rf.written == rf.len;
+  if(ok){
+    RingSlotHdr h{};
+    h.magic = SD_RING_MAGIC;
+    h.seq = rf.seq;
+    h.index = rf.index;
+    h.len = rf.len;
+    h.ts = rf.ts;
+    h.trigger = rf.trigger;
+    h.crc = crc;
+    h.hdr_crc = hdr_crc(h);
+    ok = rf.f.seek(0) && rf.f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+  }
+  rf.f.close();
+  if(ok){
+    xSemaphoreTake(g_ring_mtx, portMAX_DELAY);
+    g_ring_stats.frames++;
+    g_ring_stats.seq = rf.seq;
+    rtc_save(rf.slot, rf.seq);
+    xSemaphoreGive(g_ring_mtx);
+  }
+  return ok;
+}
+
+bool sd_ring_read_hdr(uint16_t slot, RingSlotHdr& out){
+  if(slot >= SD_RING_SLOTS) return false;
+  char path[32];
+  sd_ring_slot_path(slot, path, sizeof(path));
+  File f = SD.open(path, FILE_READ);
+  if(!f) return false;
+  bool ok = read_hdr(f, out);
+  f.close();
+  return ok;
+}
+
+bool sd_ring_find(uint32_t index, uint16_t& slot, RingSlotHdr& out){
+  if(!g_ring_ready) return false;
+  for(uint16_t s = 0; s < g_ring_have; s++){
+    if(sd_ring_read_hdr(s, out) && out.index == index){ slot = s; return true; }
+  }
+  return false;
+}
+
+bool sd_ring_last_index(uint32_t& index){
+  if(!g_ring_ready || rtc_ring_magic != RTC_RING_MAGIC) return false;
+  RingSlotHdr h;
+  if(!sd_ring_read_hdr(rtc_ring_slot, h) || h.seq != rtc_ring_seq) return false;
+  index = h.index;
+  return true;
+}
+
+void sd_ring_get_stats(RingStats& out){
+  out = g_ring_stats;
+}
\ No newline at end of file
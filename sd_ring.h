@@ -0,0 +1,70 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+
+// 循环录制：定长槽文件（/ring/R0000.bin ...）每帧原地覆盖最旧的一个（"r+" 打开），
+// 热路径上没有创建/删除/簇分配，卡永远不会写满。挂载只同步建 SD_RING_MOUNT_SLOTS 个槽，
+// 其余由写任务空闲时逐个补建（sd_ring_idle），每建一个先查剩余空间，空间不够就停在当前槽数。
+// 槽布局：[RingSlotHdr，补齐到 SD_RING_DATA_OFF][数据]。
+// 开写前先把槽头清零、最后写新头，掉电时该槽头无效，读出方据此丢弃。
+// 最近写入的槽与序号留在 RTC 内存，深睡唤醒后核对该槽头即可恢复，不必扫描全部槽。
+// 槽头即本模式的索引：不向 SD_INDEX_FILE 追加记录（旧记录会指向已被覆盖的槽），按序号查找用 sd_ring_find。
+
+#pragma pack(push,1)
+struct RingSlotHdr{
+  uint32_t magic;      // SD_RING_MAGIC
+  uint32_t seq;        // 全局递增写入序号，最大者为最新
+  uint32_t index;      // 图片序号
+  uint32_t len;
+  uint32_t ts;
+  uint8_t  trigger;
+  uint8_t  reserved[3];
+  uint32_t crc;        // 数据 CRC32
+  uint32_t hdr_crc;    // 本头前面字段的 CRC32
+};
+#pragma pack(pop)
+
+// 单帧写入上下文；写任务与同步保存路径各持有一个，互不干扰
+struct RingFrame{
+  File     f;
+  uint16_t slot;
+  uint32_t seq;
+  uint32_t index;
+  uint32_t len;
+  uint32_t ts;
+  uint32_t written;
+  uint8_t  trigger;
+};
+
+struct RingStats{
+  uint32_t slots;      // 可用槽数（补建过程中逐步增加到 SD_RING_SLOTS）
+  uint32_t created;    // 本次挂载以来新建的槽文件数
+  uint32_t mount_fail; // 挂载失败次数（失败后按退避时长不再由 sd_ring_begin 重试）
+  uint32_t frames;     // 成功写入帧数
+  uint32_t overwrites; // 覆盖了有效旧帧的次数
+  uint32_t seq;        // 最近写入序号
+};
+
+// 挂载后调用：RTC 中的位置核对通过则直接沿用，否则扫描已有槽头定位最旧槽；可重复调用。
+// 显式调用总会尝试；sd_ring_begin 内的隐式挂载在失败后按退避时长跳过
+bool sd_ring_mount();
+void sd_ring_unmount();
+// 写任务空闲时调用：补建一个缺失的槽文件；返回 true 表示还有槽待建
+bool sd_ring_idle();
+
+void sd_ring_slot_path(uint16_t slot, char* out, size_t n);
+
+// 领取下一个槽并开始写帧；len 超过槽容量时失败
+bool sd_ring_begin(RingFrame& rf, uint32_t index, uint32_t len, uint32_t ts, uint8_t trigger);
+size_t sd_ring_append(RingFrame& rf, const uint8_t* data, size_t len);
+// 写头并关闭；crc 为数据 CRC32
+bool sd_ring_end(RingFrame& rf, uint32_t crc);
+
+// 读出槽头（含校验）；用于按槽回放
+bool sd_ring_read_hdr(uint16_t slot, RingSlotHdr& out);
+// 按图片序号逐个读槽头查找（至多 SD_RING_SLOTS 次读）
+bool sd_ring_find(uint32_t index, uint16_t& slot, RingSlotHdr& out);
+// 最近写成一帧的图片序号（已挂载时）；启动恢复序号用
+bool sd_ring_last_index(uint32_t& index);
+void sd_ring_get_stats(RingStats& out);
\ No newline at end of file
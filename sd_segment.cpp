@@ -0,0 +1,188 @@
+#include "sd_segment.h"
+#include "config.h"
+#include "sd_async.h"
+#include "sd_index.h"
+#include <SD.h>
+#include <FS.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+static const uint32_t SEG_TAIL_MAX = SD_SEGMENT_MAX_FRAMES * sizeof(SegIndexEnt) + sizeof(SegFooter);
+static_assert(SD_SEGMENT_MAX_BYTES > 2 * SEG_TAIL_MAX, "segment too small for its index");
+static_assert(sizeof(SD_SEGMENT_DIR "/S00000000.bin") <= sizeof(PhotoIndexRec::path), "segment path too long for the index");
+
+static File         g_seg;
+static char         g_seg_path[32] = {0};
+static uint32_t     g_seg_pos = 0;        // 下一条帧记录的偏移
+static uint32_t     g_seg_open_ms = 0;
+static uint32_t     g_seg_unsynced = 0;
+static SegIndexEnt* g_seg_idx = nullptr;  // 尾部索引表（PSRAM）
+static uint32_t     g_seg_count = 0;
+
+static uint32_t     g_frame_off = 0;
+static uint32_t     g_frame_len = 0;
+static uint32_t     g_frame_written = 0;
+static uint32_t     g_frame_index = 0;
+static bool         g_in_frame = false;
+
+static SegStats     g_seg_stats = {};
+static const uint8_t g_zeros[SD_SEGMENT_ALIGN] = {0};
+
+static uint32_t rec_size(uint32_t len){
+  uint32_t n = sizeof(SegFrameHdr) + len + sizeof(uint32_t);
+  return (n + SD_SEGMENT_ALIGN - 1) & ~(uint32_t)(SD_SEGMENT_ALIGN - 1);
+}
+
+static bool seg_open(uint32_t first_index){
+  if(!g_seg_idx){
+    g_seg_idx = (SegIndexEnt*)heap_caps_malloc(SD_SEGMENT_MAX_FRAMES * sizeof(SegIndexEnt),
+                                               MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if(!g_seg_idx) return false;
+  }
+  if(!sd_async_space_ok(SD_SEGMENT_MAX_BYTES)) return false;
+  // 以首帧序号命名：天然有序且无需扫描目录找下一个段号
+  snprintf(g_seg_path, sizeof(g_seg_path), SD_SEGMENT_DIR "/S%08lu.bin", (unsigned long)first_index);
+  sd_index_prepare_dir(g_seg_path);
+  g_seg = SD.open(g_seg_path, FILE_WRITE);
+  if(!g_seg) return false;
+#if SD_SEGMENT_PREALLOC
+  // 一次性分配整段簇链并落盘目录项，之后的帧写入不再触发 FAT 分配
+  if(!g_seg.seek(SD_SEGMENT_MAX_BYTES - 1) || g_seg.write((uint8_t)0) != 1){
+    g_seg.close();
+    return false;
+  }
+  g_seg.flush();
+  g_seg.seek(0);
+  sd_async_note_written(SD_SEGMENT_MAX_BYTES);
+#endif
+  g_seg_pos = 0;
+  g_seg_count = 0;
+  g_seg_unsynced = 0;
+  g_seg_open_ms = millis();
+  g_seg_stats.cur_frames = 0;
+  g_seg_stats.cur_bytes = 0;
+  return true;
+}
+
+static SemaphoreHandle_t seg_mtx(){
+  static SemaphoreHandle_t m = xSemaphoreCreateMutex();
+  return m;
+}
+
+void sd_segment_lock(){ xSemaphoreTake(seg_mtx(), portMAX_DELAY); }
+void sd_segment_unlock(){ xSemaphoreGive(seg_mtx()); }
+
+static void seg_close(bool abort){
+  if(!g_seg) return;
+  g_in_frame = false;
+  if(!abort){
+    uint32_t tail = g_seg_count * sizeof(SegIndexEnt) + sizeof(SegFooter);
+#if SD_SEGMENT_PREALLOC
+    uint32_t idx_off = SD_SEGMENT_MAX_BYTES - tail;   // 尾部索引紧贴文件末尾
+#else
+    uint32_t idx_off = g_seg_pos;
+#endif
+    SegFooter ft;
+    ft.magic = SD_SEG_FOOTER_MAGIC;
+    ft.count = g_seg_count;
+    ft.index_off = idx_off;
+    ft.crc = esp_rom_crc32_le(0, (const uint8_t*)g_seg_idx, g_seg_count * sizeof(SegIndexEnt));
+    if(g_seg.seek(idx_off)){
+      g_seg.write((const uint8_t*)g_seg_idx, g_seg_count * sizeof(SegIndexEnt));
+      g_seg.write((const uint8_t*)&ft, sizeof(ft));
+    }
+#if !SD_SEGMENT_PREALLOC
+    sd_async_note_written(idx_off + tail);
+#endif
+  }
+  g_seg.close();
+  g_seg_stats.segments++;
+}
+
+void sd_segment_close(bool abort){
+  if(!g_seg) return;
+  sd_segment_lock();
+  seg_close(abort);
+  sd_segment_unlock();
+}
+
+bool sd_segment_begin(uint32_t index, uint32_t len, uint32_t ts, uint8_t trigger){
+  uint32_t need = rec_size(len);
+  if(need > SD_SEGMENT_MAX_BYTES - 2 * SEG_TAIL_MAX) return false;   // 单帧超过段容量
+  if(g_in_frame){ uint32_t off; sd_segment_end(0, off); }            // 上一帧未收尾（提交中途失败）
+  if(g_seg){
+    bool full = g_seg_count >= SD_SEGMENT_MAX_FRAMES ||
+                g_seg_pos + need > SD_SEGMENT_MAX_BYTES - SEG_TAIL_MAX;
+    bool old  = millis() - g_seg_open_ms >= SD_SEGMENT_MAX_MS;
+    if(full || old) seg_close(false);
+  }
+  if(!g_seg && !seg_open(index)) return false;
+
+  SegFrameHdr h{};
+  h.magic = SD_SEG_FRAME_MAGIC;
+  h.index = index;
+  h.len = len;
+  h.ts = ts;
+  h.trigger = trigger;
+  if(g_seg.write((const uint8_t*)&h, sizeof(h)) != sizeof(h)) return false;
+  g_frame_off = g_seg_pos;
+  g_frame_len = len;
+  g_frame_written = 0;
+  g_frame_index = index;
+  g_in_frame = true;
+  return true;
+}
+
+size_t sd_segment_append(const uint8_t* data, size_t len){
+  if(!g_seg || !g_in_frame) return 0;
+  if(g_frame_written + len > g_frame_len) len = g_frame_len - g_frame_written;
+  size_t w = g_seg.write(data, len);
+  g_frame_written += w;
+  return w;
+}
+
+bool sd_segment_end(uint32_t crc, uint32_t& off){
+  if(!g_seg || !g_in_frame) return false;
+  g_in_frame = false;
+  uint32_t size = rec_size(g_frame_len);
+  bool ok = (g_frame_written == g_frame_len);
+  if(ok){
+    ok = g_seg.write((const uint8_t*)&crc, sizeof(crc)) == sizeof(crc);
+    uint32_t pad = size - (sizeof(SegFrameHdr) + g_frame_len + sizeof(uint32_t));
+    if(ok && pad) ok = g_seg.write(g_zeros, pad) == pad;
+  }
+  // 失败时跳过整条记录，保证后续记录仍按对齐位置排列（扫描时靠 CRC 剔除）
+  g_seg_pos = g_frame_off + size;
+  if(!ok){ g_seg.seek(g_seg_pos); return false; }
+
+  SegIndexEnt& e = g_seg_idx[g_seg_count++];
+  e.index = g_frame_index;
+  e.offset = g_frame_off;
+  e.len = g_frame_len;
+  off = g_frame_off;
+  g_seg_stats.frames++;
+  g_seg_stats.cur_frames = g_seg_count;
+  g_seg_stats.cur_bytes = g_seg_pos;
+  if(++g_seg_unsynced >= SD_SEGMENT_SYNC_FRAMES){ g_seg.flush(); g_seg_unsynced = 0; }
+  return true;
+}
+
+const char* sd_segment_path(){
+  return g_seg_path;
+}
+
+void sd_segment_idle(){
+  if(!g_seg) return;
+  sd_segment_lock();
+  if(g_seg && !g_in_frame){
+    if(millis() - g_seg_open_ms >= SD_SEGMENT_MAX_MS) seg_close(false);
+    else if(g_seg_unsynced){ g_seg.flush(); g_seg_unsynced = 0; }
+  }
+  sd_segment_unlock();
+}
+
+void sd_segment_get_stats(SegStats& out){
+  out = g_seg_stats;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 容器输出：多帧顺序追加进一个大段文件，省去每张图片的目录项创建、簇链分配与关闭刷新。
+// 段文件布局（小端）：
+//   [帧记录]*  每条：SegFrameHdr + 数据 + uint32 CRC32，整体补齐到 SD_SEGMENT_ALIGN
+//   ...         预分配区剩余部分（内容未定义）
+//   SegIndexEnt[count] + SegFooter   位于文件末尾，关闭时写入
+// 掉电未写尾部索引时，可从头顺序扫描帧记录恢复（tools/seg_extract.py）。
+// 由写任务调用；同步保存路径须等写任务写完已提交的帧，并在整帧前后加 sd_segment_lock()，
+// 期间写任务的空闲刷新与关闭等待。
+
+#pragma pack(push,1)
+struct SegFrameHdr{
+  uint32_t magic;      // SD_SEG_FRAME_MAGIC
+  uint32_t index;
+  uint32_t len;        // 数据字节数（不含头尾）
+  uint32_t ts;
+  uint8_t  trigger;
+  uint8_t  reserved[3];
+};
+struct SegIndexEnt{
+  uint32_t index;
+  uint32_t offset;     // 帧记录在段内偏移
+  uint32_t len;
+};
+struct SegFooter{
+  uint32_t magic;      // SD_SEG_FOOTER_MAGIC
+  uint32_t count;
+  uint32_t index_off;  // 索引表起始偏移
+  uint32_t crc;        // 索引表 CRC32
+};
+#pragma pack(pop)
+
+struct SegStats{
+  uint32_t segments;   // 已滚动关闭的段数
+  uint32_t frames;
+  uint32_t cur_frames;
+  uint32_t cur_bytes;
+};
+
+// 开始一帧（必要时滚动到新段）；len 为整帧字节数
+bool sd_segment_begin(uint32_t index, uint32_t len, uint32_t ts, uint8_t trigger);
+size_t sd_segment_append(const uint8_t* data, size_t len);
+// 结束当前帧，写入数据 CRC；off 返回帧记录偏移
+bool sd_segment_end(uint32_t crc, uint32_t& off);
+const char* sd_segment_path();
+
+// 写任务空闲时调用：按帧数/时间刷新目录项，超时滚动
+void sd_segment_idle();
+// 写尾部索引并关闭；abort=true 时（掉卡）直接关闭
+void sd_segment_close(bool abort = false);
+// 写任务之外的调用方写一整帧时持有
+void sd_segment_lock();
+void sd_segment_unlock();
+void sd_segment_get_stats(SegStats& out);
\ No newline at end of file
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+# 校验带帧头的照片（ENABLE_FRAME_HEADER）：读 SOI 后的 CAMH 段取元数据，用文件尾 CRC 校验整文件。
+# 用法: frame_check.py IMG_*.jpg [...]    输出: 路径 序号 时间 触发 宽x高 质量 状态
+import struct, sys, zlib
+
+HDR = struct.Struct('<2s2s4sBBIIHHBbhbBI')
+TRAILER = struct.Struct('<II')
+TRAILER_MAGIC = 0x31435246
+
+
+def check(path):
+    buf = open(path, 'rb').read()
+    if len(buf) < 2 + HDR.size + TRAILER.size or buf[:2] != b'\xff\xd8':
+        return 'not a jpeg'
+    (marker, _, ident, ver, trig, index, ts, w, h, fsz, q, aec, agc, flags,
+     jlen) = HDR.unpack_from(buf, 2)
+    if marker != b'\xff\xe9' or ident != b'CAMH':
+        return 'no header'
+    info = '%u %u %u %ux%u q=%d' % (index, ts, trig, w, h, q)
+    if flags & 1:
+        crc, magic = TRAILER.unpack_from(buf, len(buf) - TRAILER.size)
+        if magic != TRAILER_MAGIC:
+            return info + ' trailer missing'
+        if zlib.crc32(buf[:-TRAILER.size]) != crc:
+            return info + ' CRC FAIL'
+    return info + ' ok'
+
+
+def main():
+    bad = 0
+    for p in sys.argv[1:]:
+        r = check(p)
+        bad += not r.endswith('ok')
+        print(p, r)
+    sys.exit(1 if bad else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# 远程升级联调用的本地块服务器：下发 CMD_REMOTE_UPGRADE_CMD，应答文件信息与块请求。
+# 可注入回复延迟、抖动、丢包与带宽限制，--stop-after 模拟中途断链以验证断点续传。
+# 用法: ota_server.py --serial /dev/ttyUSB0 firmware.bin [--loss 0.02] [--delay-ms 300] [--kbps 8] [--stop-after 200]
+#       ota_server.py --tcp 9000 firmware.bin ...
+import argparse, hashlib, random, socket, struct, threading, time
+
+from uplink_server import build, frames, _wait
+
+CMD_FILE_INFO_REQ = 0x0003
+CMD_FILE_BLOCK_REQ = 0x0004
+CMD_REMOTE_UPGRADE_CMD = 0x8005
+
+
+def serve(read, write, fw, args):
+    md5 = hashlib.md5(fw).digest()
+    lock = threading.Lock()
+    st = dict(req=0, dropped=0, served=0, uniq=set(), t0=time.time())
+
+    def send(frame):
+        with lock:
+            write(frame)
+            if args.kbps:   # 串行链路带宽
+                time.sleep(len(frame) / (args.kbps * 1024.0))
+
+    def later(frame):
+        def run():
+            if args.delay_ms or args.jitter_ms:
+                time.sleep((args.delay_ms + random.uniform(0, args.jitter_ms)) / 1000.0)
+            send(frame)
+        threading.Thread(target=run, daemon=True).start()
+
+    send(build(CMD_REMOTE_UPGRADE_CMD, 0, b'\x01'))
+    print('firmware %u B md5 %s' % (len(fw), md5.hex()))
+    for cmd, seq, payload, _ in frames(read):
+        if cmd == CMD_REMOTE_UPGRADE_CMD:
+            print('upgrade cmd resp', payload[:1].hex())
+        elif cmd == CMD_FILE_INFO_REQ:
+            print('info req')
+            later(build(CMD_FILE_INFO_REQ, seq, struct.pack('<BI', 0, len(fw)) + md5))
+        elif cmd == CMD_FILE_BLOCK_REQ and len(payload) >= 6:
+            off, n = struct.unpack_from('<IH', payload)
+            st['req'] += 1
+            if random.random() < args.loss:
+                st['dropped'] += 1
+                continue
+            data = fw[off:off + n]
+            later(build(CMD_FILE_BLOCK_REQ, seq, struct.pack('<BIH', 0, off, len(data)) + data))
+            st['served'] += 1
+            st['uniq'].add(off)
+            got = len(st['uniq']) * n
+            if st['served'] % 64 == 0:
+                dt = time.time() - st['t0']
+                print('%u/%u B req=%u dropped=%u %.1f kB/s' % (
+                    min(got, len(fw)), len(fw), st['req'], st['dropped'], got / 1024.0 / max(dt, 1e-3)))
+            if args.stop_after and st['served'] >= args.stop_after:
+                print('stopping after %u blocks' % st['served'])
+                return
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument('--serial')
+    src.add_argument('--tcp', type=int, metavar='PORT')
+    ap.add_argument('firmware')
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--loss', type=float, default=0.0, help='块请求丢弃率')
+    ap.add_argument('--delay-ms', type=float, default=0.0)
+    ap.add_argument('--jitter-ms', type=float, default=0.0)
+    ap.add_argument('--kbps', type=float, default=0.0, help='下行带宽限制 kB/s，0=不限')
+    ap.add_argument('--stop-after', type=int, default=0, help='应答这么多块后断开')
+    args = ap.parse_args()
+    fw = open(args.firmware, 'rb').read()
+
+    if args.serial:
+        import serial
+        port = serial.Serial(args.serial, args.baud, timeout=0.05)
+        serve(lambda: port.read(4096) or _wait(port), port.write, fw, args)
+    else:
+        srv = socket.socket()
+        srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        srv.bind(('', args.tcp))
+        srv.listen(1)
+        conn, peer = srv.accept()
+        print('connected', peer)
+        serve(lambda: conn.recv(4096), conn.sendall, fw, args)
+        conn.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# 从段容器文件 (/seg/S*.bin) 中导出 JPEG。
+# 优先读尾部索引；段未正常关闭（掉电）时从头按对齐记录扫描，靠 CRC 剔除坏帧。
+# 用法: seg_extract.py S00001234.bin [...] -o out_dir
+import argparse, os, struct, zlib
+
+FRAME_MAGIC = 0x314D5246   # "FRM1"
+FOOTER_MAGIC = 0x58444953  # "SIDX"
+ALIGN = 512
+HDR = struct.Struct('<IIIIB3x')
+ENT = struct.Struct('<III')
+FOOT = struct.Struct('<IIII')
+
+
+def read_frame(buf, off):
+    if off + HDR.size > len(buf):
+        return None
+    magic, index, n, ts, trig = HDR.unpack_from(buf, off)
+    end = off + HDR.size + n
+    if magic != FRAME_MAGIC or end + 4 > len(buf):
+        return None
+    data = buf[off + HDR.size:end]
+    crc, = struct.unpack_from('<I', buf, end)
+    if zlib.crc32(data) != crc:
+        return None
+    return index, ts, trig, data
+
+
+def frames_from_index(buf):
+    if len(buf) < FOOT.size:
+        return None
+    magic, count, idx_off, crc = FOOT.unpack_from(buf, len(buf) - FOOT.size)
+    if magic != FOOTER_MAGIC:
+        return None
+    table = buf[idx_off:idx_off + count * ENT.size]
+    if len(table) != count * ENT.size or zlib.crc32(table) != crc:
+        return None
+    out = []
+    for i in range(count):
+        _, off, _ = ENT.unpack_from(table, i * ENT.size)
+        f = read_frame(buf, off)
+        if f:
+            out.append(f)
+    return out
+
+
+def frames_by_scan(buf):
+    out, off = [], 0
+    while off + HDR.size <= len(buf):
+        magic, = struct.unpack_from('<I', buf, off)
+        if magic == FRAME_MAGIC:
+            f = read_frame(buf, off)
+            if f:
+                out.append(f)
+                n = HDR.size + len(f[3]) + 4
+                off += (n + ALIGN - 1) // ALIGN * ALIGN
+                continue
+        off += ALIGN
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('segments', nargs='+')
+    ap.add_argument('-o', '--out', default='.')
+    args = ap.parse_args()
+    os.makedirs(args.out, exist_ok=True)
+    for path in args.segments:
+        with open(path, 'rb') as fp:
+            buf = fp.read()
+        frames = frames_from_index(buf)
+        how = 'index'
+        if frames is None:
+            frames, how = frames_by_scan(buf), 'scan'
+        for index, ts, trig, data in frames:
+            with open(os.path.join(args.out, '%08u.jpg' % index), 'wb') as fp:
+                fp.write(data)
+        print('%s: %d frames (%s)' % (path, len(frames), how))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+# 图片上传联调用的本地平台替身：收 CMD_IMAGE_UPLOAD 包、逐包确认、拼图落盘。
+# 可注入丢包与确认延迟，用来观察设备端滑动窗口重传与节流（设备端 's' 统计中的 uplink 行）。
+# 用法: uplink_server.py --serial /dev/ttyUSB0 [--baud 115200] [--loss 0.05] [--delay-ms 80] [--jitter-ms 40] -o out_dir
+#       uplink_server.py --tcp 9000 ...      （设备以 TCP 客户端连上时）
+import argparse, os, random, socket, struct, threading, time
+
+SYNC = b'\x7e\x7e'
+HDR = struct.Struct('<2sBBIHHH')   # sync ver dmodel slave_id cmd seq len
+META = struct.Struct('<IIIHH')     # image_id total_len offset pkt_idx pkt_cnt
+ACK = struct.Struct('<IHB')        # image_id pkt_idx resp
+CMD_IMAGE_UPLOAD = 0x1F00
+CMD_S_IMAGE_ACK = CMD_IMAGE_UPLOAD | 0x8000
+MAX_LEN = 4096
+
+
+def crc16(data, crc=0):
+    # 与 esp_rom_crc16_le 相同（CRC-16/X-25，可分段累加）
+    crc = ~crc & 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return ~crc & 0xFFFF
+
+
+def build(cmd, seq, payload, ver=0x5B, dmodel=0x1F, slave=1):
+    h = HDR.pack(SYNC, ver, dmodel, slave, cmd, seq, len(payload))
+    return h + payload + struct.pack('<H', crc16(h[2:] + payload))
+
+
+def frames(read):
+    # 逐字节找同步头，长度或 CRC 不对就丢一个字节重找
+    buf = bytearray()
+    while True:
+        chunk = read()
+        if not chunk:
+            return
+        buf += chunk
+        while True:
+            i = buf.find(SYNC)
+            if i < 0:
+                del buf[:-1]
+                break
+            del buf[:i]
+            if len(buf) < HDR.size:
+                break
+            _, ver, dmodel, slave, cmd, seq, n = HDR.unpack_from(buf)
+            if n > MAX_LEN:
+                del buf[:1]
+                continue
+            end = HDR.size + n + 2
+            if len(buf) < end:
+                break
+            crc, = struct.unpack_from('<H', buf, end - 2)
+            if crc16(bytes(buf[2:end - 2])) != crc:
+                del buf[:1]
+                continue
+            yield cmd, seq, bytes(buf[HDR.size:end - 2]), (ver, dmodel, slave)
+            del buf[:end]
+
+
+class Image:
+    def __init__(self, total, cnt):
+        self.data = bytearray(total)
+        self.have = set()
+        self.cnt = cnt
+        self.t0 = time.time()
+
+
+def serve(read, write, args):
+    images = {}
+    lock = threading.Lock()
+    seq = [0]
+    stats = dict(pkts=0, dropped=0, dup=0, images=0)
+
+    def ack(hdr_ids, image_id, idx):
+        def send():
+            if args.delay_ms or args.jitter_ms:
+                time.sleep((args.delay_ms + random.uniform(0, args.jitter_ms)) / 1000.0)
+            ver, dmodel, slave = hdr_ids
+            with lock:
+                seq[0] = (seq[0] + 1) & 0xFFFF
+                write(build(CMD_S_IMAGE_ACK, seq[0], ACK.pack(image_id, idx, 0), ver, dmodel, slave))
+        threading.Thread(target=send, daemon=True).start()
+
+    for cmd, _, payload, ids in frames(read):
+        if cmd != CMD_IMAGE_UPLOAD or len(payload) < META.size:
+            continue
+        stats['pkts'] += 1
+        if random.random() < args.loss:      # 当作数据包丢失：不收不确认
+            stats['dropped'] += 1
+            continue
+        image_id, total, off, idx, cnt = META.unpack_from(payload)
+        chunk = payload[META.size:]
+        img = images.get(image_id)
+        if img is None or len(img.data) != total:
+            img = images[image_id] = Image(total, cnt)
+        if idx in img.have:
+            stats['dup'] += 1
+        elif off + len(chunk) <= total:
+            img.data[off:off + len(chunk)] = chunk
+            img.have.add(idx)
+        if random.random() >= args.loss:     # 确认丢失
+            ack(ids, image_id, idx)
+        if len(img.have) == img.cnt:
+            path = os.path.join(args.out, 'IMG_%08u.jpg' % image_id)
+            with open(path, 'wb') as f:
+                f.write(img.data)
+            dt = time.time() - img.t0
+            stats['images'] += 1
+            print('%s %u B in %.2fs (%.1f kB/s) pkts=%u dropped=%u dup=%u' % (
+                path, total, dt, total / 1024.0 / max(dt, 1e-3),
+                stats['pkts'], stats['dropped'], stats['dup']))
+            del images[image_id]
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument('--serial')
+    src.add_argument('--tcp', type=int, metavar='PORT')
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--loss', type=float, default=0.0, help='丢包率（数据包与确认各自独立）')
+    ap.add_argument('--delay-ms', type=float, default=0.0)
+    ap.add_argument('--jitter-ms', type=float, default=0.0)
+    ap.add_argument('-o', '--out', default='.')
+    args = ap.parse_args()
+    os.makedirs(args.out, exist_ok=True)
+
+    if args.serial:
+        import serial
+        port = serial.Serial(args.serial, args.baud, timeout=0.05)
+        serve(lambda: port.read(4096) or _wait(port), port.write, args)
+    else:
+        srv = socket.socket()
+        srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        srv.bind(('', args.tcp))
+        srv.listen(1)
+        while True:
+            conn, peer = srv.accept()
+            print('connected', peer)
+            serve(lambda: conn.recv(4096), conn.sendall, args)
+            conn.close()
+
+
+def _wait(port):
+    # 串口超时返回空串会被当作 EOF，这里阻塞到有数据
+    while True:
+        b = port.read(1)
+        if b:
+            return b
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,200 @@
+#include "uplink.h"
+#include "fb_ref.h"
+#include "proto.h"
+#include "perf_stats.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <atomic>
+
+static const uint16_t UP_MAX_PKTS = (IMAGE_MAX_LEN + UPLINK_PKT_PAYLOAD - 1) / UPLINK_PKT_PAYLOAD;
+static_assert(UP_MAX_PKTS <= 64, "acked bitmap is 64 bits");
+static_assert(UPLINK_WINDOW <= 32, "window too large");
+static_assert(UPLINK_QUEUE_LEN < CAMERA_FB_COUNT, "uplink must leave the driver a free frame buffer");
+
+struct UpJob{ camera_fb_t* fb; uint32_t index; };
+
+static QueueHandle_t g_upq = nullptr;
+static TaskHandle_t  g_up_task = nullptr;
+static UplinkStats   g_up = {};
+static std::atomic<uint32_t> g_held{0};   // 排队 + 正在发送的帧，各占一个驱动缓冲
+static std::atomic<bool> g_abort{false};  // uplink_release_fbs 进行中
+
+// ---- 令牌桶：单位为毫秒，每包消耗 PROTO_MIN_SEND_INTERVAL_MS ----
+static uint32_t g_tb_ms = 0;
+static uint32_t g_tb_last = 0;
+
+static bool token_take(){
+#if PROTO_MIN_SEND_INTERVAL_MS == 0
+  return true;
+#else
+  const uint32_t cap = (uint32_t)UPLINK_BURST * PROTO_MIN_SEND_INTERVAL_MS;
+  uint32_t now = millis();
+  g_tb_ms += now - g_tb_last;
+  g_tb_last = now;
+  if(g_tb_ms > cap) g_tb_ms = cap;
+  if(g_tb_ms < PROTO_MIN_SEND_INTERVAL_MS){ g_up.throttled++; return false; }
+  g_tb_ms -= PROTO_MIN_SEND_INTERVAL_MS;
+  return true;
+#endif
+}
+
+// ---- 确认：由协议接收任务置位，上传任务取走 ----
+static portMUX_TYPE g_ack_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool         g_ack_busy = false;
+static uint32_t     g_ack_image = 0;
+static uint64_t     g_ack_bits = 0;
+
+static void on_image_ack(const ProtoFrame& f){
+  if(f.len < sizeof(ImgAck)) return;
+  ImgAck a;
+  proto_copy(f, 0, &a, sizeof(a));
+  if(a.resp != RESP_OK || a.pkt_idx >= 64) return;
+  portENTER_CRITICAL(&g_ack_mux);
+  bool mine = g_ack_busy && a.image_id == g_ack_image;
+  if(mine) g_ack_bits |= 1ULL << a.pkt_idx;
+  portEXIT_CRITICAL(&g_ack_mux);
+  if(mine) xTaskNotifyGive(g_up_task);
+}
+
+static void ack_track(bool busy, uint32_t image_id){
+  portENTER_CRITICAL(&g_ack_mux);
+  g_ack_busy = busy;
+  g_ack_image = image_id;
+  g_ack_bits = 0;
+  portEXIT_CRITICAL(&g_ack_mux);
+}
+
+// 合并新到的确认，返回新确认的包数
+static uint32_t poll_acks(uint64_t& acked){
+  portENTER_CRITICAL(&g_ack_mux);
+  uint64_t bits = g_ack_bits;
+  portEXIT_CRITICAL(&g_ack_mux);
+  uint32_t got = __builtin_popcountll(bits & ~acked);
+  acked |= bits;
+  g_up.acks += got;
+  return got;
+}
+
+// ---- 发送：包头与帧缓冲中的数据分散写出，不经暂存区 ----
+static void send_image_pkt(const camera_fb_t* fb, uint32_t image_id, uint16_t idx, uint16_t cnt){
+  uint32_t off = (uint32_t)idx * UPLINK_PKT_PAYLOAD;
+  uint32_t n = fb->len - off;
+  if(n > UPLINK_PKT_PAYLOAD) n = UPLINK_PKT_PAYLOAD;
+
+  ImgPktMeta m;
+  m.image_id = image_id;
+  m.total_len = fb->len;
+  m.offset = off;
+  m.pkt_idx = idx;
+  m.pkt_cnt = cnt;
+
+  ProtoIov iov[2] = { { &m, sizeof(m) }, { fb->buf + off, (uint16_t)n } };
+  proto_send_v(CMD_IMAGE_UPLOAD, iov, 2);
+  g_up.pkts_sent++;
+  g_up.bytes_sent += sizeof(ProtoHdr) + sizeof(m) + n + 2;
+}
+
+// 滑动窗口：base 为最早未确认包，最多 UPLINK_WINDOW 个在途；超时包单独重传
+static bool send_image(const UpJob& j){
+  const camera_fb_t* fb = j.fb;
+  uint16_t cnt = (uint16_t)((fb->len + UPLINK_PKT_PAYLOAD - 1) / UPLINK_PKT_PAYLOAD);
+  uint64_t acked = 0;
+  uint32_t sent_ms[UPLINK_WINDOW];
+  uint8_t  tries[UPLINK_WINDOW];
+  uint16_t base = 0, next = 0;
+  uint32_t progress_ms = millis();
+
+  while(true){
+    if(g_abort) return false;
+    if(poll_acks(acked)) progress_ms = millis();
+    while(base < cnt && (acked >> base) & 1) base++;
+    if(base >= cnt) return true;
+    uint32_t now = millis();
+    if(now - progress_ms >= IMAGE_ACK_TIMEOUT_MS) return false;
+
+    bool blocked = false;
+    for(uint16_t i = base; i < next && !blocked; i++){
+      if((acked >> i) & 1) continue;
+      uint8_t w = i % UPLINK_WINDOW;
+      if(now - sent_ms[w] < UPLINK_RTO_MS) continue;
+      if(tries[w] > IMAGE_MAX_RETRIES) return false;
+      if(!token_take()){ blocked = true; break; }
+      send_image_pkt(fb, j.index, i, cnt);
+      sent_ms[w] = now;
+      tries[w]++;
+      g_up.pkts_retx++;
+    }
+    while(!blocked && next < cnt && next < base + UPLINK_WINDOW){
+      if(!token_take()){ blocked = true; break; }
+      uint8_t w = next % UPLINK_WINDOW;
+      send_image_pkt(fb, j.index, next, cnt);
+      sent_ms[w] = now;
+      tries[w] = 1;
+      next++;
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(2));   // 确认到达即醒
+  }
+}
+
+static void uplink_task(void*){
+  UpJob j;
+  g_tb_last = millis();
+  g_tb_ms = (uint32_t)UPLINK_BURST * PROTO_MIN_SEND_INTERVAL_MS;
+  while(true){
+    if(xQueueReceive(g_upq, &j, portMAX_DELAY) != pdTRUE) continue;
+    uint32_t t0 = millis();
+    ack_track(true, j.index);
+    bool ok = !g_abort && send_image(j);
+    ack_track(false, 0);   // 之后迟到的确认直接丢弃
+    fb_ref_release(j.fb);
+    g_held.fetch_sub(1);
+    if(ok){ g_up.images_ok++; g_up.last_image_ms = millis() - t0; }
+    else g_up.images_fail++;
+  }
+}
+
+static void dump_stats(Print& out){
+  UplinkStats us;
+  uplink_get_stats(us);
+  out.printf("uplink: ok=%lu fail=%lu skip=%lu pkts=%lu retx=%lu acks=%lu %luKB throttled=%lu last=%lums\n",
+             (unsigned long)us.images_ok, (unsigned long)us.images_fail, (unsigned long)us.images_skipped,
+             (unsigned long)us.pkts_sent, (unsigned long)us.pkts_retx, (unsigned long)us.acks,
+             (unsigned long)(us.bytes_sent / 1024), (unsigned long)us.throttled, (unsigned long)us.last_image_ms);
+}
+
+bool uplink_begin(){
+  if(g_up_task) return true;
+  perf_add_dump(dump_stats);
+  if(!proto_on(CMD_S_IMAGE_ACK, on_image_ack)) return false;
+  g_upq = xQueueCreate(UPLINK_QUEUE_LEN, sizeof(UpJob));
+  if(!g_upq) return false;
+  return xTaskCreatePinnedToCore(uplink_task, "upl", UPLINK_TASK_STACK, nullptr,
+                                 UPLINK_TASK_PRIO, &g_up_task, UPLINK_TASK_CORE) == pdPASS;
+}
+
+bool uplink_submit_fb(camera_fb_t* fb, uint32_t index){
+  if(!g_upq || !fb) return false;
+  if(fb->len > IMAGE_MAX_LEN || g_abort){ g_up.images_skipped++; return false; }
+  if(g_held.fetch_add(1) >= UPLINK_QUEUE_LEN){
+    g_held.fetch_sub(1);
+    g_up.images_skipped++;
+    return false;
+  }
+  UpJob j{ fb, index };
+  if(xQueueSend(g_upq, &j, 0) != pdTRUE){ g_held.fetch_sub(1); g_up.images_skipped++; return false; }
+  g_up.queued++;
+  return true;
+}
+
+void uplink_release_fbs(){
+  if(!g_up_task || !g_held) return;
+  g_abort = true;
+  xTaskNotifyGive(g_up_task);   // 正在等确认的发送立即醒来放弃
+  while(g_held) vTaskDelay(1);
+  g_abort = false;
+}
+
+void uplink_get_stats(UplinkStats& out){
+  out = g_up;
+}
\ No newline at end of file
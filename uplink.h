@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "config.h"
+
+// 图片上传（CMD_IMAGE_UPLOAD）：直接读写卡任务同时持有的帧缓冲（fb_ref 引用计数），不再拷贝 JPEG。
+// 帧格式见 proto.h；图片包 payload：ImgPktMeta（IMAGE_META_LEN 字节）+ 至多 UPLINK_PKT_PAYLOAD 字节数据
+// 平台逐包确认：cmd=CMD_S_IMAGE_ACK，payload 为 ImgAck
+// 发送端保持 UPLINK_WINDOW 个未确认包（选择重传），按令牌桶节流，速率为每 PROTO_MIN_SEND_INTERVAL_MS 一包
+
+#define CMD_S_IMAGE_ACK (CMD_IMAGE_UPLOAD | 0x8000)
+
+#pragma pack(push,1)
+struct ImgPktMeta{
+  uint32_t image_id;   // 照片序号
+  uint32_t total_len;
+  uint32_t offset;
+  uint16_t pkt_idx;
+  uint16_t pkt_cnt;
+};
+struct ImgAck{
+  uint32_t image_id;
+  uint16_t pkt_idx;
+  uint8_t  resp;       // RESP_*
+};
+#pragma pack(pop)
+static_assert(sizeof(ImgPktMeta) == IMAGE_META_LEN, "image meta size");
+
+struct UplinkStats{
+  uint32_t images_ok;
+  uint32_t images_fail;      // 重传用尽或 IMAGE_ACK_TIMEOUT_MS 内无进展
+  uint32_t images_skipped;   // 超过 IMAGE_MAX_LEN 或上一帧尚未发完
+  uint32_t pkts_sent;
+  uint32_t pkts_retx;
+  uint32_t acks;
+  uint32_t bytes_sent;
+  uint32_t throttled;        // 令牌不足而推迟发送的次数
+  uint32_t last_image_ms;
+  uint32_t queued;
+};
+
+// 须在 proto_begin() 之后调用
+bool uplink_begin();
+// 提交一帧；调用方须已为本次交接 fb_ref_add()，失败时由调用方释放该引用
+bool uplink_submit_fb(camera_fb_t* fb, uint32_t index);
+// 放弃在发与排队的帧并等到不再持有任何帧缓冲（esp_camera_deinit 之前调用），期间的提交被拒绝
+void uplink_release_fbs();
+void uplink_get_stats(UplinkStats& out);
\ No newline at end of file